@@ -0,0 +1,86 @@
+#include "alias_table.h"
+#include <cmath>
+#include <algorithm>
+
+AliasTable::AliasTable() : bins(), pdfs() {}
+
+AliasTable::AliasTable(const std::vector<float>& weights)
+  : bins(weights.size()), pdfs(weights.size())
+{
+  const size_t n = weights.size();
+  if (n == 0) {
+    return;
+  }
+
+  double total = 0.0;
+  for (float w : weights) {
+    if (std::isfinite(w) && w > 0.0f) {
+      total += double(w);
+    }
+  }
+
+  // Normalize the weights; degenerate input falls back to a uniform choice.
+  for (size_t i = 0; i < n; ++i) {
+    float w = weights[i];
+    if (total > 0.0) {
+      bool valid = std::isfinite(w) && w > 0.0f;
+      pdfs[i] = valid ? float(double(w) / total) : 0.0f;
+    } else {
+      pdfs[i] = 1.0f / float(n);
+    }
+  }
+
+  // Partition the scaled probabilities into under-full and over-full bins,
+  // then repeatedly top up an under-full bin with an over-full one.
+  std::vector<double> scaled(n);
+  std::vector<size_t> small;
+  std::vector<size_t> large;
+  for (size_t i = 0; i < n; ++i) {
+    scaled[i] = double(pdfs[i]) * double(n);
+    if (scaled[i] < 1.0) {
+      small.push_back(i);
+    } else {
+      large.push_back(i);
+    }
+  }
+
+  while (!small.empty() && !large.empty()) {
+    size_t s = small.back();
+    small.pop_back();
+    size_t l = large.back();
+
+    bins[s].threshold = float(scaled[s]);
+    bins[s].alias = l;
+
+    scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+    if (scaled[l] < 1.0) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+
+  // Anything left over is full up to rounding error.
+  for (size_t i : large) {
+    bins[i].threshold = 1.0f;
+    bins[i].alias = i;
+  }
+  for (size_t i : small) {
+    bins[i].threshold = 1.0f;
+    bins[i].alias = i;
+  }
+}
+
+size_t AliasTable::sample(Randomness& rng, float* pdfOut) const {
+  const size_t n = bins.size();
+
+  // One uniform number picks both the column and the threshold test.
+  float u = rng.nextUnitFloat() * float(n);
+  size_t idx = std::min(size_t(u), n - 1);
+  float frac = u - float(idx);
+
+  size_t chosen = frac < bins[idx].threshold ? idx : bins[idx].alias;
+  if (pdfOut) {
+    *pdfOut = pdfs[chosen];
+  }
+  return chosen;
+}
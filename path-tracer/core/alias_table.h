@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+#include "randomness.h"
+
+/**
+ * A discrete probability distribution over a fixed number of items that can
+ * be sampled in constant time using Walker's alias method. Each item is chosen
+ * with a probability proportional to the (non-negative) weight it was given
+ * when the table was built.
+ *
+ * See Vose, "A Linear Algorithm for Generating Random Numbers with a Given
+ * Distribution" (IEEE TSE, 1991) for the construction used here.
+ */
+class AliasTable {
+  /** A single column of the table. */
+  struct Bin {
+    float threshold; /**< Probability of keeping this bin's own item. */
+    size_t alias; /**< The item chosen if the threshold test fails. */
+  };
+
+  std::vector<Bin> bins; /**< The columns of the table, one per item. */
+  std::vector<float> pdfs; /**< The normalized probability of each item. */
+
+public:
+  /**
+   * Constructs an empty table. Sampling an empty table is not allowed.
+   */
+  AliasTable();
+
+  /**
+   * Constructs a table from the given weights. If all weights are zero (or
+   * there are no finite positive weights), every item is equally likely.
+   *
+   * @param weights the relative weights of the items; must not be negative
+   */
+  AliasTable(const std::vector<float>& weights);
+
+  /** Returns the number of items in the table. */
+  inline size_t size() const { return bins.size(); }
+
+  /** Returns true if the table has no items. */
+  inline bool empty() const { return bins.empty(); }
+
+  /**
+   * Returns the probability that the given item is chosen by
+   * AliasTable::sample.
+   */
+  inline float pdf(size_t idx) const { return pdfs[idx]; }
+
+  /**
+   * Chooses an item in constant time.
+   *
+   * @param rng          the per-thread RNG in use
+   * @param pdfOut [out] the probability of choosing the returned item; may be
+   *                     null if the probability is not needed
+   * @returns            the index of the chosen item
+   */
+  size_t sample(Randomness& rng, float* pdfOut = nullptr) const;
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <atomic>
+
+/**
+ * A float that many threads can add to at once without locking.
+ */
+class AtomicFloat {
+  std::atomic<float> value;
+
+public:
+  AtomicFloat(float v = 0.0f) : value(v) {}
+  AtomicFloat(const AtomicFloat& other) : value(other.load()) {}
+
+  inline AtomicFloat& operator=(const AtomicFloat& other) {
+    value.store(other.load(), std::memory_order_relaxed);
+    return *this;
+  }
+
+  inline float load() const {
+    return value.load(std::memory_order_relaxed);
+  }
+
+  inline void add(float f) {
+    float old = load();
+    while (!value.compare_exchange_weak(old, old + f,
+                                        std::memory_order_relaxed)) {}
+  }
+};
@@ -1,26 +1,51 @@
 #include "camera.h"
+#include <algorithm>
 #include <iostream>
 #include <chrono>
+#include <boost/format.hpp>
+#include "cpu_dispatch.h"
 #include "light.h"
+#include "lights/all.h"
 
 using std::max;
 using std::min;
+using boost::format;
 namespace chrono = std::chrono;
 
 Camera::Camera(
   const Transform& xform,
   const std::vector<const Geom*>& objs,
+  const InfiniteLight* env,
   long ww,
   long hh,
   float fov,
   float len,
-  float fStop
-) : accel(objs), focalLength(len),
+  float fStop,
+  Integrator integ,
+  int dn,
+  bool cache,
+  bool direct,
+  bool clamp,
+  bool adj,
+  int lc
+) : integrator(integ), requestedIntegrator(integ), accel(objs),
+    useRadianceCache(cache), clampRadiance(clamp),
+    adjointRussianRoulette(adj), lightCandidates(lc),
+    sceneBounds(Vec(0, 0, 0)), tiles(ww, hh, RenderPool::shared().size()),
+    bidirectional(*this), photonMapping(*this), instantRadiosity(*this),
+    metropolis(*this, tiles.size()), focalLength(len),
     lensRadius((len / fStop) * 0.5f), // Diameter = focalLength / fStop.
-    camToWorldXform(xform),
-    masterRng(), rowSeeds(size_t(hh)), img(ww, hh), iters(0),
-    pool(MAX_THREADS)
+    camToWorldXform(xform), worldToCamXform(xform.inverse()),
+    masterRng(), tileSeeds(tiles.size()), img(ww, hh),
+    denoiseInterval(dn), iters(0),
+    pool(RenderPool::shared())
 {
+  if (lightCandidates < 1) {
+    throw std::runtime_error(
+      str(format("%1% is not a valid number of light candidates") % lc)
+    );
+  }
+
   // Calculate ray-tracing vectors.
   float halfFocalPlaneUp;
   float halfFocalPlaneRight;
@@ -37,12 +62,100 @@ Camera::Camera(
   focalPlaneRight = 2.0f * halfFocalPlaneRight;
   focalPlaneOrigin = Vec(-halfFocalPlaneRight, halfFocalPlaneUp, -focalLength);
 
+  // Scenes without specular materials get a kernel that never checks for
+  // them.
+  bool specular = false;
+  for (size_t i = 0; i < objs.size(); ++i) {
+    objectIds[objs[i]] = int(i) + 1;
+    if (objs[i]->mat) {
+      materials.add(objs[i]->mat);
+      if (!objs[i]->mat->shouldDirectIlluminate()) {
+        specular = true;
+      }
+    }
+  }
+  traceKernel = selectTraceKernel(direct, clamp, specular);
+
+  // Cache cells cover about as many pixels anywhere in the image.
+  if (cache || adj) {
+    radianceCache = RadianceCache(
+      camToWorldXform * Vec(0, 0, 0),
+      RADIANCE_CACHE_CELL_PIXELS * focalPlaneRight
+        / (float(img.w - 1) * focalLength)
+    );
+  }
+
+  // Far-away emitters are better handled as lights at infinity.
+  std::vector<const Geom*> visibleObjs = promoteDistantEmitters(objs);
+  if (visibleObjs.size() != objs.size()) {
+    accel = LinearTime(visibleObjs);
+  }
+
   // Refine emitters so we can compute direct illumination.
-  for (const Geom* g : objs) {
+  for (const Geom* g : visibleObjs) {
     if (g->light) {
       g->refine(emitters);
     }
   }
+
+  // Bright emitters should be chosen for direct illumination more often than
+  // dim ones, so weight them by power.
+  std::vector<float> emitterPowers;
+  for (const Geom* g : emitters) {
+    emitterIndices[g] = emitterPowers.size();
+    emitterPowers.push_back(g->light->power(g));
+  }
+  emitterDistribution = AliasTable(emitterPowers);
+
+  // With many emitters, most of them are too far away or facing the wrong way
+  // to matter at any given point, so use the light tree instead.
+  if (emitters.size() >= LIGHT_TREE_MIN_EMITTERS) {
+    emitterTree = LightTree(emitters);
+  }
+
+  BBox sceneBox;
+  for (size_t i = 0; i < visibleObjs.size(); ++i) {
+    if (i == 0) {
+      sceneBox = visibleObjs[i]->boundBox();
+    } else {
+      sceneBox.expand(visibleObjs[i]->boundBox());
+    }
+  }
+  guidingTree = SDTree(sceneBox);
+  sceneBounds = BSphere(sceneBox);
+
+  // Lights at infinity are chosen against the emitters as a whole. The
+  // emitters that became distant lights used to hide the environment behind
+  // them, and still should.
+  if (env && !distantLights.empty()) {
+    std::vector<const lights::Distant*> occluders;
+    for (const auto& d : distantLights) {
+      occluders.push_back(d.get());
+    }
+    occludedEnvironment.reset(new lights::Occluded(env, occluders));
+    env = occludedEnvironment.get();
+  }
+  if (env) {
+    infiniteLights.push_back(env);
+  }
+
+  if (!infiniteLights.empty()) {
+    float emitterPower = 0.0f;
+    for (float p : emitterPowers) {
+      emitterPower += p;
+    }
+
+    std::vector<float> groupPowers;
+    groupPowers.push_back(emitterPower);
+    for (const InfiniteLight* l : infiniteLights) {
+      groupPowers.push_back(l->power(sceneBounds));
+    }
+    lightGroupDistribution = AliasTable(groupPowers);
+  } else if (!emitters.empty()) {
+    lightGroupDistribution = AliasTable(std::vector<float>(1, 1.0f));
+  }
+
+  restart();
 }
 
 Camera::Camera(const Node& n)
@@ -52,33 +165,182 @@ Camera::Camera(const Node& n)
              n.getVec("translate")
            ),
            n.getGeometryList("objects"),
+           n.getEnvironment("environment"),
            n.getInt("width"), n.getInt("height"),
            n.getFloat("fov"), n.getFloat("focalLength"),
-           n.getFloat("fStop")) {}
+           n.getFloat("fStop"),
+           integratorFromName(n.getString("integrator", "path")),
+           n.getInt("denoiseInterval", 0),
+           n.getBool("radianceCache", false),
+           n.getBool("directLighting", true),
+           n.getBool("clampRadiance", true),
+           n.getBool("adjointRussianRoulette", false),
+           n.getInt("lightCandidates", 1)) {}
+
+void Camera::restart() {
+  img.clear();
+  iters = 0;
+
+  photonMapping.restart();
+  metropolis.restart();
+}
+
+Camera::Integrator Camera::integratorFromName(const std::string& name) {
+  if (name == "path") {
+    return Integrator::PATH;
+  } else if (name == "bdpt") {
+    return Integrator::BIDIRECTIONAL;
+  } else if (name == "ppm") {
+    return Integrator::PHOTON_MAPPING;
+  } else if (name == "mlt") {
+    return Integrator::METROPOLIS;
+  } else if (name == "ao") {
+    return Integrator::AMBIENT_OCCLUSION;
+  } else if (name == "direct") {
+    return Integrator::DIRECT;
+  } else if (name == "albedo") {
+    return Integrator::ALBEDO;
+  } else if (name == "vpl") {
+    return Integrator::INSTANT_RADIOSITY;
+  }
+
+  throw std::runtime_error(
+    str(format("%1% is not a recognized integrator") % name)
+  );
+}
+
+std::vector<const Geom*> Camera::promoteDistantEmitters(
+  const std::vector<const Geom*>& objs
+) {
+  // Only geometry with a material can receive light; pure emitters can't.
+  BBox receiverBox;
+  bool anyReceivers = false;
+  for (const Geom* g : objs) {
+    if (!g->mat) {
+      continue;
+    }
+
+    if (anyReceivers) {
+      receiverBox.expand(g->boundBox());
+    } else {
+      receiverBox = g->boundBox();
+      anyReceivers = true;
+    }
+  }
+
+  if (!anyReceivers) {
+    return objs;
+  }
+
+  BSphere receivers(receiverBox);
+  std::vector<const Geom*> remaining;
+  for (const Geom* g : objs) {
+    // Emitters that also reflect light must stay in the scene.
+    lights::Distant* distant = nullptr;
+    if (g->light && !g->mat) {
+      distant = lights::Distant::fromEmitter(
+        g,
+        receivers,
+        lights::Distant::TOLERANCE
+      );
+    }
+
+    if (distant) {
+      distantLights.emplace_back(distant);
+      infiniteLights.push_back(distant);
+    } else {
+      remaining.push_back(g);
+      if (g->light && !g->mat && g->isSpherical()) {
+        float variation =
+          lights::Distant::variation(g->boundSphere(), receivers);
+        std::cout << "Kept an emitter as geometry: "
+          << (variation < math::VERY_BIG
+              ? str(format("it varies by %1%%% across the scene, over the "
+                           "%2%%% allowed")
+                    % (100.0f * variation)
+                    % (100.0f * lights::Distant::TOLERANCE))
+              : std::string("the scene reaches into its radius"))
+          << "\n";
+      }
+    }
+  }
+
+  if (!distantLights.empty()) {
+    std::cout << "Replaced " << distantLights.size()
+      << " far-away emitter(s) with distant lights\n";
+  }
+
+  return remaining;
+}
+
+void Camera::setIntegrator(Integrator integ) {
+  requestedIntegrator = integ;
+}
 
 void Camera::renderOnce(std::atomic<bool>& needsUpdate) {
+  // The image only holds one integrator's estimate, so start over when
+  // switching between them.
+  Integrator requested = requestedIntegrator.load();
+  if (requested != integrator) {
+    integrator = requested;
+    restart();
+  }
+
   // Increment iteration count and begin timer.
   iters++;
   std::cout << "Iteration " << iters;
   chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
 
-  // Seed the per-row RNGs.
-  for (long y = 0; y < img.h; ++y) {
-    rowSeeds[size_t(y)] = masterRng.nextUnsigned();
+  // Seed the per-tile RNGs.
+  for (unsigned& seed : tileSeeds) {
+    seed = masterRng.nextUnsigned();
+  }
+
+  if (integrator == Integrator::PHOTON_MAPPING) {
+    photonMapping.tracePhotons();
+  } else if (integrator == Integrator::INSTANT_RADIOSITY) {
+    instantRadiosity.traceVirtualLights();
+  } else if (integrator == Integrator::METROPOLIS && !metropolis.started()) {
+    metropolis.startChains();
+  }
+
+  // Trace paths in parallel, with one task per worker taking tiles until
+  // none are left.
+  tiles.reset();
+  pool.dispatch(tiles.workers(), &Camera::renderWorkFunc, this);
+
+  // Later iterations gather photons over a smaller radius, and scale the
+  // Markov chains' samples by a better estimate of the average luminance.
+  if (integrator == Integrator::PHOTON_MAPPING) {
+    photonMapping.shrinkRadius(iters);
+  } else if (integrator == Integrator::METROPOLIS) {
+    metropolis.refineNormalization();
   }
 
-  // Trace paths in parallel.
-  pool.Dispatch(img.h, &Camera::renderWorkFunc, this);
+  // Learn from this iteration's paths before guiding the next iteration's.
+  // Only the plain path tracer records into the tree and the cache.
+  if (integrator == Integrator::PATH) {
+    guidingTree.refine();
+    radianceCache.update();
+  }
 
   // Process and report to NaCl that the current iteration is done.
   img.commitSamples();
+  if (denoiseInterval > 0 && iters % denoiseInterval == 0) {
+    img.denoise(&pool);
+  }
   needsUpdate = true;
 
   // End timer.
   chrono::steady_clock::time_point endTime = chrono::steady_clock::now();
   chrono::duration<float> runTime =
     chrono::duration_cast<chrono::duration<float>>(endTime - startTime);
-  std::cout << " [" << runTime.count() << " seconds]\n";
+  std::cout << " [" << runTime.count() << " seconds, "
+    << cpu::instructionSetName(cpu::instructionSet()) << "]\n";
+}
+
+float Camera::iterationProgress() const {
+  return tiles.progress();
 }
 
 void Camera::renderMultiple(std::atomic<bool>& needsUpdate, int iterations) {
@@ -101,14 +363,111 @@ void Camera::renderMultiple(std::atomic<bool>& needsUpdate, int iterations) {
 
 Vec Camera::trace(
   LightRay r,
-  Randomness& rng
+  Randomness& rng,
+  float pixelLuminance,
+  Image::Features* featuresOut
+) const {
+  return (this->*traceKernel)(r, rng, pixelLuminance, featuresOut);
+}
+
+Camera::TraceKernel Camera::selectTraceKernel(
+  bool direct,
+  bool clamp,
+  bool specular
+) {
+  // Indexed by direct, clamp, and specular, in that order.
+  static const TraceKernel kernels[2][2][2] = {
+    {
+      {
+        &Camera::traceWith<TracePolicy<false, false, false>>,
+        &Camera::traceWith<TracePolicy<false, false, true>>
+      },
+      {
+        &Camera::traceWith<TracePolicy<false, true, false>>,
+        &Camera::traceWith<TracePolicy<false, true, true>>
+      }
+    },
+    {
+      {
+        &Camera::traceWith<TracePolicy<true, false, false>>,
+        &Camera::traceWith<TracePolicy<true, false, true>>
+      },
+      {
+        &Camera::traceWith<TracePolicy<true, true, false>>,
+        &Camera::traceWith<TracePolicy<true, true, true>>
+      }
+    }
+  };
+
+  return kernels[direct][clamp][specular];
+}
+
+template<typename Policy>
+Vec Camera::traceWith(
+  LightRay r,
+  Randomness& rng,
+  float pixelLuminance,
+  Image::Features* featuresOut
+) const {
+  // Some paths are traced to the end regardless of the radiance cache, to
+  // keep it learning.
+  PathState start;
+  start.depth = 0;
+  start.diffuseBounces = 0;
+  start.didDirectIlluminate = false;
+  start.scatterPdf = 0.0f;
+  start.windowed = false;
+  start.training = integrator == Integrator::PATH && useRadianceCache
+    && rng.nextUnitFloat() < RADIANCE_CACHE_TRAINING_PROBABILITY;
+
+  Vec L = tracePath<Policy>(r, rng, pixelLuminance, start, featuresOut);
+
+  if (Policy::clamping) {
+    L[0] = math::clamp(L[0], 0.0f, BIASED_RADIANCE_CLAMPING);
+    L[1] = math::clamp(L[1], 0.0f, BIASED_RADIANCE_CLAMPING);
+    L[2] = math::clamp(L[2], 0.0f, BIASED_RADIANCE_CLAMPING);
+  }
+
+  return L;
+}
+
+template<typename Policy>
+Vec Camera::tracePath(
+  LightRay r,
+  Randomness& rng,
+  float pixelLuminance,
+  const PathState& start,
+  Image::Features* featuresOut
 ) const {
   Vec L(0, 0, 0);
-  bool didDirectIlluminate = false;
+  float pathLength = 0.0f;
 
-  for (int depth = 0; ; ++depth) {
-    // Do Russian Roulette if this path is "old".
-    if (depth >= RUSSIAN_ROULETTE_DEPTH_1 || r.isBlack()) {
+  // When the previous bounce sampled the lights directly, emission found by
+  // its BSDF-sampled ray must be weighted against that light sample.
+  bool didDirectIlluminate = start.didDirectIlluminate;
+  Intersection prevIsect = start.prevIsect;
+  float scatterPdf = start.scatterPdf;
+  bool windowed = start.windowed;
+  int diffuseBounces = start.diffuseBounces;
+
+  // Metropolis sampling needs every path to have a fixed contribution, so
+  // only the plain path tracer learns and follows the guiding distribution.
+  const bool guided =
+    integrator == Integrator::PATH && GUIDING_PROBABILITY > 0.0f;
+  // Likewise, only the plain path tracer learns and uses the cache.
+  const bool learning =
+    integrator == Integrator::PATH && radianceCache.enabled();
+  const bool cached = learning && useRadianceCache && !start.training;
+  const bool adjoint =
+    learning && adjointRussianRoulette && pixelLuminance > 0.0f;
+
+  GuidingRecord records[MAX_GUIDING_RECORDS];
+  int numRecords = 0;
+
+  for (int depth = start.depth; ; ++depth) {
+    // Do Russian Roulette if this path is "old", unless it was just played
+    // against what the path is expected to contribute.
+    if (!windowed && (depth >= RUSSIAN_ROULETTE_DEPTH_1 || r.isBlack())) {
       float rv = rng.nextUnitFloat();
 
       float probLive;
@@ -129,107 +488,778 @@ Vec Camera::trace(
         break;
       }
     }
+    windowed = false;
 
     // Bounce ray and kill if nothing hit.
     Intersection isect;
     const Geom* g = accel.intersect(r, &isect);
     if (!g) {
-      // End path in empty space.
+      // End path in empty space, picking up any light from infinity.
+      for (size_t i = 0; i < infiniteLights.size(); ++i) {
+        Vec emission = r.color.cwiseProduct(
+          infiniteLights[i]->emit(r.direction)
+        );
+        if (!Policy::directLighting || !didDirectIlluminate) {
+          L += emission;
+        } else {
+          float lightPdf = sampleOneLightPDF(i, r.direction);
+          L += emission * math::powerHeuristic(1, scatterPdf, 1, lightPdf);
+        }
+      }
       break;
     }
 
+    pathLength += isect.distance;
+    recordFeatures(g, isect, pathLength, &featuresOut);
+
     // Check for lighting.
-    if (g->light && !didDirectIlluminate) {
+    if (g->light && (!Policy::directLighting || !didDirectIlluminate)) {
       // Accumulate emission normally.
       L += r.color.cwiseProduct(g->light->emit(r, isect));
-    } else if (g->light && didDirectIlluminate) {
-      // Skip emission accumulation because it was accumulated already
-      // in a direct lighting calculation. We don't want to double-count.
+    } else if (g->light) {
+      // This is the material-sampling half of the previous bounce's direct
+      // lighting estimate, so weight it against the light-sampling half.
+      float lightPdf = sampleOneLightPDF(prevIsect, g, r.direction);
+      float weight = math::powerHeuristic(1, scatterPdf, 1, lightPdf);
+      L += r.color.cwiseProduct(g->light->emit(r, isect)) * weight;
     }
 
     // Check for scattering (reflection/transmission).
     if (!g->mat) {
       // Cannot continue path without a material.
       break;
-    } else if (g->mat && !g->mat->shouldDirectIlluminate()) {
+    } else if (Policy::specular && !g->mat->shouldDirectIlluminate()) {
       // Continue path normally.
       r = g->mat->scatter(rng, r, isect);
       didDirectIlluminate = false;
-    } else if (g->mat && g->mat->shouldDirectIlluminate()) {
-#ifndef NO_DIRECT_ILLUM
-      // Sample direct lighting and then continue path.
-      L += r.color.cwiseProduct(
-        uniformSampleOneLight(rng, r, isect, g->mat)
+    } else {
+      // The lights and every continuation share one shading frame.
+      ShadingContext ctx(isect, -r.direction, g->mat);
+      const DTree* guide = guided
+        ? guidingTree.samplingTree(isect.position)
+        : nullptr;
+      if (Policy::directLighting) {
+        // Sample direct lighting and then continue path. The continuation
+        // ray doubles as the material sample for the direct lighting
+        // estimate.
+        L += r.color.cwiseProduct(sampleOneLight(rng, ctx, guide));
+        didDirectIlluminate = true;
+      }
+      Vec normal = isect.normal.dot(r.direction) > 0.0f
+        ? Vec(-isect.normal)
+        : isect.normal;
+      Vec cachedRadiance;
+      bool known = (cached || adjoint) && radianceCache.lookup(
+        rng,
+        isect.position,
+        normal,
+        &cachedRadiance
       );
-      r = g->mat->scatter(rng, r, isect);
-      didDirectIlluminate = true;
-#else
-      // Continue path normally.
-      r = g->mat->scatter(rng, r, isect);
-      didDirectIlluminate = false;
-#endif
+
+      // Past the first diffuse bounce, the light arriving along the
+      // continuation varies smoothly, so use the cache's average instead.
+      if (cached && known && diffuseBounces > 0) {
+        r = guidedScatter(rng, r, ctx, guide, &scatterPdf);
+        L += r.color.cwiseProduct(cachedRadiance);
+        break;
+      }
+      ++diffuseBounces;
+
+      // Keep the continuation's expected contribution within a window around
+      // the pixel's value, by Russian Roulette below it and by splitting
+      // above it. See Vorba & Krivanek, "Adjoint-Driven Russian Roulette and
+      // Splitting in Light Transport Simulation" (2016).
+      int splits = 1;
+      if (adjoint && known) {
+        float expected = math::luminance(
+          r.color.cwiseProduct(g->mat->baseColor()).cwiseProduct(cachedRadiance)
+        ) / pixelLuminance;
+        float lower = 2.0f / (1.0f + ADJOINT_WINDOW_SIZE);
+        float upper = lower * ADJOINT_WINDOW_SIZE;
+
+        if (expected < lower) {
+          float probLive = max(expected / lower, ADJOINT_MIN_SURVIVAL);
+          if (rng.nextUnitFloat() >= probLive) {
+            break;
+          }
+          r.color = r.color / probLive;
+        } else if (expected > upper) {
+          splits = min(int(ceilf(expected / upper)), MAX_SPLITS);
+        }
+        windowed = true;
+      }
+
+      if (splits > 1) {
+        // Each split continuation carries its share of the throughput, and
+        // is traced to the end before the next one starts.
+        PathState next;
+        next.depth = depth + 1;
+        next.diffuseBounces = diffuseBounces;
+        next.didDirectIlluminate = didDirectIlluminate;
+        next.prevIsect = isect;
+        next.windowed = true;
+        next.training = start.training;
+
+        for (int i = 0; i < splits; ++i) {
+          LightRay branch =
+            guidedScatter(rng, r, ctx, guide, &next.scatterPdf);
+          branch.color = branch.color / float(splits);
+
+          GuidingRecord rec{
+            isect.position,
+            normal,
+            branch.direction,
+            branch.color,
+            L,
+            next.scatterPdf
+          };
+          L += tracePath<Policy>(branch, rng, pixelLuminance, next, nullptr);
+          if (next.scatterPdf > 0.0f) {
+            recordVertex(rec, L, guided, learning);
+          }
+        }
+        break;
+      }
+
+      // Continue path, guided towards where light was found before.
+      Vec radianceBefore = L;
+      r = guidedScatter(rng, r, ctx, guide, &scatterPdf);
+      prevIsect = isect;
+
+      if ((guided || learning) && numRecords < MAX_GUIDING_RECORDS
+          && scatterPdf > 0.0f) {
+        records[numRecords++] = GuidingRecord{
+          isect.position,
+          normal,
+          r.direction,
+          r.color,
+          radianceBefore,
+          scatterPdf
+        };
+      }
     }
   }
 
-  L[0] = math::clamp(L[0], 0.0f, BIASED_RADIANCE_CLAMPING);
-  L[1] = math::clamp(L[1], 0.0f, BIASED_RADIANCE_CLAMPING);
-  L[2] = math::clamp(L[2], 0.0f, BIASED_RADIANCE_CLAMPING);
+  for (int i = 0; i < numRecords; ++i) {
+    recordVertex(records[i], L, guided, learning);
+  }
 
   return L;
 }
 
-Vec Camera::uniformSampleOneLight(
+void Camera::recordVertex(
+  const GuidingRecord& rec,
+  const Vec& radianceAfter,
+  bool guided,
+  bool cached
+) const {
+  // Everything gathered after a vertex arrived there along the continuation
+  // ray, scaled by the throughput; undo the scaling to find the radiance.
+  Vec radiance = radianceAfter - rec.radianceBefore;
+  for (int c = 0; c < 3; ++c) {
+    radiance[c] = rec.throughput[c] > 0.0f
+      ? radiance[c] / rec.throughput[c]
+      : 0.0f;
+  }
+
+  if (guided) {
+    guidingTree.record(
+      rec.position,
+      rec.direction,
+      math::luminance(radiance) / rec.pdf
+    );
+  }
+  // The cache averages over the cosine-weighted hemisphere, which is what
+  // ends paths on diffuse surfaces, whatever they were sampled by. Guided
+  // directions below the surface carry no light, and are left out.
+  float cosPdf = rec.normal.dot(rec.direction) * math::INV_PI;
+  if (cached && cosPdf > 0.0f) {
+    radianceCache.record(
+      rec.position,
+      rec.normal,
+      radiance,
+      cosPdf / rec.pdf
+    );
+  }
+}
+
+LightRay Camera::guidedScatter(
   Randomness& rng,
   const LightRay& incoming,
-  const Intersection& isect,
-  const Material* mat
+  const ShadingContext& ctx,
+  const DTree* guide,
+  float* pdfOut
+) const {
+  if (!guide) {
+    return ctx.mat->scatter(rng, incoming, ctx, pdfOut);
+  }
+
+  const Intersection& isect = ctx.isect;
+  Vec outgoing;
+  Vec bsdf;
+  float bsdfPdf;
+  float guidePdf;
+  if (rng.nextUnitFloat() < GUIDING_PROBABILITY) {
+    outgoing = guide->sample(rng, &guidePdf);
+    ctx.mat->evalWorld(ctx, outgoing, &bsdf, &bsdfPdf);
+  } else {
+    ctx.mat->sampleWorld(ctx, rng, &outgoing, &bsdf, &bsdfPdf);
+    guidePdf = guide->pdf(outgoing);
+  }
+
+  float pdf = GUIDING_PROBABILITY * guidePdf
+    + (1.0f - GUIDING_PROBABILITY) * bsdfPdf;
+  *pdfOut = pdf;
+
+  Vec scale;
+  if (pdf > 0.0f) {
+    scale = bsdf * fabsf(isect.normal.dot(outgoing)) / pdf;
+  } else {
+    scale = Vec(0, 0, 0);
+  }
+
+  return LightRay(
+    isect.position + outgoing * math::VERY_SMALL,
+    outgoing,
+    incoming.color.cwiseProduct(scale)
+  );
+}
+
+Vec Camera::sampleOneLight(
+  Randomness& rng,
+  const ShadingContext& ctx,
+  const DTree* guide
 ) const {
-  size_t numLights = emitters.size();
-  if (numLights == 0) {
+  if (lightGroupDistribution.empty()) {
+    return Vec(0, 0, 0);
+  } else if (lightCandidates > 1) {
+    return resampleOneLight(rng, ctx, guide);
+  }
+
+  const Intersection& isect = ctx.isect;
+  float groupPdf;
+  size_t group = lightGroupDistribution.sample(rng, &groupPdf);
+  if (group > 0) {
+    return infiniteLights[group - 1]->directIlluminate(
+      rng, ctx, &accel, groupPdf, guide, GUIDING_PROBABILITY
+    );
+  } else if (emitters.empty()) {
     return Vec(0, 0, 0);
   }
 
-  size_t lightIdx = size_t(floorf(rng.nextUnitFloat() * numLights));
-  const Geom* emitter = emitters[min(lightIdx, numLights - 1)];
+  float lightSelectPdf;
+  size_t lightIdx;
+  if (!emitterTree.empty()) {
+    int treeIdx =
+      emitterTree.sample(rng, isect.position, isect.normal, &lightSelectPdf);
+    if (treeIdx < 0) {
+      return Vec(0, 0, 0);
+    }
+    lightIdx = size_t(treeIdx);
+  } else {
+    lightIdx = emitterDistribution.sample(rng, &lightSelectPdf);
+  }
+
+  const Geom* emitter = emitters[lightIdx];
   const AreaLight* areaLight = emitter->light;
 
-  // P[this light] = 1 / numLights, so 1 / P[this light] = numLights.
-  return float(numLights) * areaLight->directIlluminate(
-    rng, incoming, isect, mat, emitter, &accel
+  // The light scales its contribution by 1 / P[this light] and accounts for
+  // P[this light] in its MIS weights.
+  return areaLight->directIlluminate(
+    rng, ctx, emitter, &accel, groupPdf * lightSelectPdf, guide,
+    GUIDING_PROBABILITY
   );
 }
 
-void Camera::renderWorkFunc(int task_index, void* data) {
-  Camera* c = reinterpret_cast<Camera*>(data);
-  const long y = task_index;
+void Camera::sampleUnoccludedLight(
+  Randomness& rng,
+  const Intersection& isect,
+  Vec* dirOut,
+  Vec* colorOut,
+  float* pdfOut,
+  float* distOut
+) const {
+  *pdfOut = 0.0f;
+
+  float groupPdf;
+  size_t group = lightGroupDistribution.sample(rng, &groupPdf);
+  if (group > 0) {
+    infiniteLights[group - 1]->sampleDirection(rng, dirOut, colorOut, pdfOut);
+    *pdfOut *= groupPdf;
+    *distOut = math::VERY_BIG;
+    return;
+  } else if (emitters.empty()) {
+    return;
+  }
+
+  float lightSelectPdf;
+  size_t lightIdx;
+  if (!emitterTree.empty()) {
+    int treeIdx =
+      emitterTree.sample(rng, isect.position, isect.normal, &lightSelectPdf);
+    if (treeIdx < 0) {
+      return;
+    }
+    lightIdx = size_t(treeIdx);
+  } else {
+    lightIdx = emitterDistribution.sample(rng, &lightSelectPdf);
+  }
+
+  const Geom* emitter = emitters[lightIdx];
+  emitter->light->sampleLight(
+    rng, nullptr, emitter, isect.position, dirOut, colorOut, pdfOut, distOut
+  );
+  *pdfOut *= groupPdf * lightSelectPdf;
+}
+
+Vec Camera::resampleOneLight(
+  Randomness& rng,
+  const ShadingContext& ctx,
+  const DTree* guide
+) const {
+  const Intersection& isect = ctx.isect;
+
+  // Keep one candidate with a weighted reservoir, targeting the luminance of
+  // the unshadowed contribution.
+  float weightSum = 0.0f;
+  float chosenTarget = 0.0f;
+  float chosenPdf = 0.0f;
+  float chosenDist = 0.0f;
+  Vec chosenDir(0, 0, 0);
+  Vec chosenContribution(0, 0, 0);
+
+  for (int i = 0; i < lightCandidates; ++i) {
+    Vec dir;
+    Vec color;
+    float pdf;
+    float dist;
+    sampleUnoccludedLight(rng, isect, &dir, &color, &pdf, &dist);
+    if (pdf <= 0.0f || math::isVectorExactlyZero(color)) {
+      continue;
+    }
+
+    Vec bsdf;
+    float bsdfPdf;
+    ctx.mat->evalWorld(ctx, dir, &bsdf, &bsdfPdf);
+    Vec contribution = bsdf.cwiseProduct(color)
+      * fabsf(isect.normal.dot(dir));
+
+    float target = math::luminance(contribution);
+    if (target <= 0.0f) {
+      continue;
+    }
+
+    float weight = target / pdf;
+    weightSum += weight;
+    if (rng.nextUnitFloat() * weightSum <= weight) {
+      chosenTarget = target;
+      chosenPdf = pdf;
+      chosenDist = dist;
+      chosenDir = dir;
+      chosenContribution = contribution;
+    }
+  }
+
+  if (chosenTarget <= 0.0f) {
+    return Vec(0, 0, 0);
+  }
+
+  Ray shadow(isect.position + math::VERY_SMALL * chosenDir, chosenDir);
+  float maxDist = chosenDist >= math::VERY_BIG
+    ? math::VERY_BIG
+    : (1.0f - math::VERY_SMALL) * chosenDist - 2.0f * math::VERY_SMALL;
+  if (accel.intersectShadow(shadow, maxDist)) {
+    return Vec(0, 0, 0);
+  }
+
+  // The MIS weights only need to sum to one with the material strategy's, so
+  // the candidates' own probability stands in for the resampled one.
+  Vec bsdf;
+  float bsdfPdf;
+  ctx.mat->evalWorld(ctx, chosenDir, &bsdf, &bsdfPdf);
+  if (guide) {
+    bsdfPdf = GUIDING_PROBABILITY * guide->pdf(chosenDir)
+      + (1.0f - GUIDING_PROBABILITY) * bsdfPdf;
+  }
+  float misWeight = math::powerHeuristic(1, chosenPdf, 1, bsdfPdf);
+
+  return chosenContribution * (misWeight * weightSum
+    / (chosenTarget * float(lightCandidates)));
+}
+
+float Camera::sampleOneLightPDF(
+  const Intersection& isect,
+  const Geom* emitter,
+  const Vec& dir
+) const {
+  auto it = emitterIndices.find(emitter);
+  if (it == emitterIndices.end()) {
+    return 0.0f;
+  }
+
+  float lightSelectPdf;
+  if (!emitterTree.empty()) {
+    lightSelectPdf =
+      emitterTree.pdf(isect.position, isect.normal, int(it->second));
+  } else {
+    lightSelectPdf = emitterDistribution.pdf(it->second);
+  }
+
+  return lightGroupDistribution.pdf(0) * lightSelectPdf
+    * emitter->pdf(isect.position, dir);
+}
+
+float Camera::sampleOneLightPDF(size_t lightIdx, const Vec& dir) const {
+  return lightGroupDistribution.pdf(lightIdx + 1)
+    * infiniteLights[lightIdx]->pdf(dir);
+}
+
+Vec Camera::traceDirect(
+  LightRay r,
+  Randomness& rng,
+  Image::Features* featuresOut
+) const {
+  Vec L(0, 0, 0);
+  float pathLength = 0.0f;
+
+  for (int depth = 0; depth < MAX_PHOTON_DEPTH; ++depth) {
+    Intersection isect;
+    const Geom* g = accel.intersect(r, &isect);
+    if (!g) {
+      for (const InfiniteLight* light : infiniteLights) {
+        L += r.color.cwiseProduct(light->emit(r.direction));
+      }
+      break;
+    }
+
+    pathLength += isect.distance;
+    recordFeatures(g, isect, pathLength, &featuresOut);
+
+    if (g->light) {
+      L += r.color.cwiseProduct(g->light->emit(r, isect));
+    }
+
+    if (!g->mat) {
+      break;
+    } else if (!g->mat->shouldDirectIlluminate()) {
+      // Photons can't be gathered on specular surfaces, so follow the path.
+      r = g->mat->scatter(rng, r, isect);
+      continue;
+    }
+
+    // Direct lighting is sampled just like in Camera::trace, with the
+    // material-sampling half found by a single extra ray.
+    ShadingContext ctx(isect, -r.direction, g->mat);
+    L += r.color.cwiseProduct(sampleOneLight(rng, ctx, nullptr));
+
+    float scatterPdf;
+    LightRay next = g->mat->scatter(rng, r, ctx, &scatterPdf);
+    Intersection lightIsect;
+    const Geom* lightGeom = accel.intersect(next, &lightIsect);
+    if (!lightGeom) {
+      for (size_t i = 0; i < infiniteLights.size(); ++i) {
+        float lightPdf = sampleOneLightPDF(i, next.direction);
+        L += next.color.cwiseProduct(infiniteLights[i]->emit(next.direction))
+          * math::powerHeuristic(1, scatterPdf, 1, lightPdf);
+      }
+    } else if (lightGeom->light) {
+      float lightPdf = sampleOneLightPDF(isect, lightGeom, next.direction);
+      L += next.color.cwiseProduct(lightGeom->light->emit(next, lightIsect))
+        * math::powerHeuristic(1, scatterPdf, 1, lightPdf);
+    }
 
-  Randomness rng(c->rowSeeds[size_t(y)]);
-  for (long x = 0; x < c->img.w; ++x) {
-    for (long samp = 0; samp < c->img.samplesPerPixel; ++samp) {
-      float offsetY = rng.nextFloat(-c->img.filterWidth, c->img.filterWidth);
-      float offsetX = rng.nextFloat(-c->img.filterWidth, c->img.filterWidth);
+    // The photons carry all of the indirect lighting, caustics included;
+    // the virtual lights carry the light that bounced off diffuse surfaces.
+    if (integrator == Integrator::PHOTON_MAPPING) {
+      L += r.color.cwiseProduct(photonMapping.gather(ctx));
+    } else if (integrator == Integrator::INSTANT_RADIOSITY) {
+      L += r.color.cwiseProduct(instantRadiosity.gather(ctx, rng));
+    }
+    break;
+  }
 
-      float posY = float(y) + offsetY;
-      float posX = float(x) + offsetX;
+  if (clampRadiance) {
+    L[0] = math::clamp(L[0], 0.0f, BIASED_RADIANCE_CLAMPING);
+    L[1] = math::clamp(L[1], 0.0f, BIASED_RADIANCE_CLAMPING);
+    L[2] = math::clamp(L[2], 0.0f, BIASED_RADIANCE_CLAMPING);
+  }
 
-      float fracY = posY / (float(c->img.h) - 1.0f);
-      float fracX = posX / (float(c->img.w) - 1.0f);
+  return L;
+}
 
-      // Implement depth of field by jittering the eye.
-      Vec offset(c->focalPlaneRight * fracX, c->focalPlaneUp * fracY, 0);
-      Vec lookAt = c->focalPlaneOrigin + offset;
+void Camera::recordFeatures(
+  const Geom* g,
+  const Intersection& isect,
+  float depth,
+  Image::Features** featuresOut
+) const {
+  if (!*featuresOut || (g->mat && !g->mat->shouldDirectIlluminate())) {
+    return;
+  }
 
-      Vec eye(0, 0, 0);
-      math::areaSampleDisk(rng, &eye[0], &eye[1]);
-      eye = eye * c->lensRadius;
+  // Emitters without a material have no albedo, but still have edges.
+  Image::Features* f = *featuresOut;
+  f->albedo = g->mat ? g->mat->baseColor() : Vec(0, 0, 0);
+  f->normal = isect.normal;
+  f->depth = depth;
+  f->objectId = objectIds.at(g);
+  *featuresOut = nullptr;
+}
 
-      Vec eyeWorld = c->camToWorldXform * eye;
-      Vec lookAtWorld = c->camToWorldXform * lookAt;
-      Vec dir = (lookAtWorld - eyeWorld).normalized();
+Vec Camera::tracePreview(
+  const LightRay& r,
+  Randomness& rng,
+  Image::Features* featuresOut
+) const {
+  Intersection isect;
+  const Geom* g = accel.intersect(r, &isect);
+  if (!g) {
+    // Nothing occludes the sky, which keeps its color in the flat preview.
+    if (integrator == Integrator::AMBIENT_OCCLUSION) {
+      return Vec(1, 1, 1);
+    }
 
-      Vec L = c->trace(LightRay(eyeWorld, dir), rng);
-      c->img.setSample(x, y, posX, posY, samp, L);
+    Vec L(0, 0, 0);
+    for (const InfiniteLight* light : infiniteLights) {
+      L += light->emit(r.direction);
     }
+    return L;
+  }
+
+  recordFeatures(g, isect, isect.distance, &featuresOut);
+  Vec normal = isect.normal.dot(r.direction) > 0.0f
+    ? Vec(-isect.normal)
+    : isect.normal;
+
+  if (integrator == Integrator::ALBEDO) {
+    Vec color(0, 0, 0);
+    if (g->mat) {
+      color = g->mat->baseColor();
+    } else if (g->light) {
+      color = g->light->emit(r, isect);
+    }
+    return color * fabsf(normal.dot(r.direction));
+  }
+
+  // Count the cosine-weighted rays that escape nearby geometry.
+  Vec tangent;
+  Vec binormal;
+  math::coordSystem(normal, &tangent, &binormal);
+  float maxDist = AMBIENT_OCCLUSION_DISTANCE * focalLength;
+
+  int unoccluded = 0;
+  for (int i = 0; i < AMBIENT_OCCLUSION_RAYS; ++i) {
+    Vec dir = math::localToWorld(
+      math::cosineSampleHemisphere(rng, false),
+      tangent,
+      binormal,
+      normal
+    );
+    Ray ray(isect.position + normal * math::VERY_SMALL, dir);
+    if (!accel.intersectShadow(ray, maxDist)) {
+      unoccluded++;
+    }
+  }
+
+  return Vec(1, 1, 1) * (float(unoccluded) / float(AMBIENT_OCCLUSION_RAYS));
+}
+
+bool Camera::sampleLightRay(Randomness& rng, LightRay* rayOut) const {
+  if (lightGroupDistribution.empty()) {
+    return false;
+  }
+
+  float groupPdf;
+  size_t group = lightGroupDistribution.sample(rng, &groupPdf);
+
+  if (group > 0) {
+    // Light from infinity arrives in parallel over a disc facing it that
+    // covers the whole scene.
+    const InfiniteLight* light = infiniteLights[group - 1];
+    Vec toLight;
+    Vec color;
+    float pdfDir;
+    light->sampleDirection(rng, &toLight, &color, &pdfDir);
+    if (pdfDir <= 0.0f) {
+      return false;
+    }
+
+    Vec tangent;
+    Vec binormal;
+    math::coordSystem(toLight, &tangent, &binormal);
+    float diskX;
+    float diskY;
+    math::areaSampleDisk(rng, &diskX, &diskY);
+
+    float radius = sceneBounds.radius;
+    Vec origin = sceneBounds.origin
+      + radius * (toLight + diskX * tangent + diskY * binormal);
+    Vec power = color * (math::PI * radius * radius / (pdfDir * groupPdf));
+    *rayOut = LightRay(origin, -toLight, power);
+    return true;
+  } else if (!emitters.empty()) {
+    float choosePdf;
+    const Geom* emitter =
+      emitters[emitterDistribution.sample(rng, &choosePdf)];
+
+    Vec position;
+    Vec normal;
+    emitter->samplePosition(rng, &position, &normal);
+
+    // The cosine-weighted direction cancels against the cosine in the
+    // emitted power.
+    Vec tangent;
+    Vec binormal;
+    math::coordSystem(normal, &tangent, &binormal);
+    Vec local = math::cosineSampleHemisphere(rng, false);
+    Vec dir = math::localToWorld(local, tangent, binormal, normal);
+
+    Vec power = emitter->light->color
+      * (math::PI * emitter->area() / (groupPdf * choosePdf));
+    *rayOut = LightRay(position + dir * math::VERY_SMALL, dir, power);
+    return true;
+  }
+
+  return false;
+}
+
+float Camera::cameraPdfDir(const Vec& dir) const {
+  Vec dirCam = worldToCamXform.linear() * dir;
+  float cosTheta = -dirCam.z() / dirCam.norm();
+  if (cosTheta <= 0.0f) {
+    return 0.0f;
+  }
+
+  // Rays are spread uniformly over the focal plane, which lies at a distance
+  // of focalLength / cosTheta along the ray, and is tilted by theta.
+  float pixelWidth = fabsf(focalPlaneRight) / float(img.w - 1);
+  float pixelHeight = fabsf(focalPlaneUp) / float(img.h - 1);
+  float filmArea = pixelWidth * pixelHeight * float(img.w * img.h);
+  return (focalLength * focalLength)
+    / (cosTheta * cosTheta * cosTheta * filmArea);
+}
+
+bool Camera::projectToFilm(
+  const Vec& lensPoint,
+  const Vec& dir,
+  float* posXOut,
+  float* posYOut
+) const {
+  Vec lensCam = worldToCamXform * lensPoint;
+  Vec dirCam = worldToCamXform.linear() * dir;
+  if (dirCam.z() >= 0.0f) {
+    return false;
+  }
+
+  Vec focalPoint = lensCam + dirCam * (focalLength / -dirCam.z());
+  float fracX = (focalPoint.x() - focalPlaneOrigin.x()) / focalPlaneRight;
+  float fracY = (focalPoint.y() - focalPlaneOrigin.y()) / focalPlaneUp;
+  *posXOut = fracX * (float(img.w) - 1.0f);
+  *posYOut = fracY * (float(img.h) - 1.0f);
+  return isOnFilm(*posXOut, *posYOut);
+}
+
+bool Camera::isOnFilm(float posX, float posY) const {
+  return posX >= -0.5f && posX < float(img.w) - 0.5f
+    && posY >= -0.5f && posY < float(img.h) - 0.5f;
+}
+
+bool Camera::unoccluded(const Vec& a, const Vec& b) const {
+  Vec dir = b - a;
+  float dist = dir.norm();
+  if (dist == 0.0f) {
+    return true;
+  }
+  dir = dir / dist;
+
+  // Stop a little short of both ends, which lie exactly on geometry.
+  Ray shadow(a + math::VERY_SMALL * dir, dir);
+  float maxDist = (1.0f - math::VERY_SMALL) * dist - 2.0f * math::VERY_SMALL;
+  return !accel.intersectShadow(shadow, maxDist);
+}
+
+LightRay Camera::cameraRay(Randomness& rng, float posX, float posY) const {
+  float fracY = posY / (float(img.h) - 1.0f);
+  float fracX = posX / (float(img.w) - 1.0f);
+
+  // Implement depth of field by jittering the eye.
+  Vec offset(focalPlaneRight * fracX, focalPlaneUp * fracY, 0);
+  Vec lookAt = focalPlaneOrigin + offset;
+
+  Vec eye(0, 0, 0);
+  math::areaSampleDisk(rng, &eye[0], &eye[1]);
+  eye = eye * lensRadius;
+
+  Vec eyeWorld = camToWorldXform * eye;
+  Vec lookAtWorld = camToWorldXform * lookAt;
+  Vec dir = (lookAtWorld - eyeWorld).normalized();
+  return LightRay(eyeWorld, dir);
+}
+
+void Camera::renderTile(size_t idx) {
+  const TileScheduler::Tile& tile = tiles[idx];
+
+  Randomness rng(tileSeeds[idx]);
+  if (integrator == Integrator::METROPOLIS) {
+    // The chains only splat, but every pixel still needs filtered samples.
+    metropolis.advanceChain(
+      idx,
+      rng,
+      (tile.x1 - tile.x0) * (tile.y1 - tile.y0) * img.samplesPerPixel
+    );
+
+    for (long y = tile.y0; y < tile.y1; ++y) {
+      for (long x = tile.x0; x < tile.x1; ++x) {
+        for (long samp = 0; samp < img.samplesPerPixel; ++samp) {
+          img.setSample(x, y, float(x), float(y), samp, Vec(0, 0, 0));
+        }
+      }
+    }
+    return;
+  }
+
+  for (long y = tile.y0; y < tile.y1; ++y) {
+    for (long x = tile.x0; x < tile.x1; ++x) {
+      for (long samp = 0; samp < img.samplesPerPixel; ++samp) {
+        float offsetY = rng.nextFloat(-img.filterWidth, img.filterWidth);
+        float offsetX = rng.nextFloat(-img.filterWidth, img.filterWidth);
+
+        float posY = float(y) + offsetY;
+        float posX = float(x) + offsetX;
+        LightRay r = cameraRay(rng, posX, posY);
+
+        // Rays that escape the scene leave the features at zero.
+        Vec L;
+        Image::Features features;
+        if (integrator == Integrator::BIDIRECTIONAL) {
+          L = bidirectional.trace(r, isOnFilm(posX, posY), rng);
+        } else if (integrator == Integrator::PHOTON_MAPPING
+                   || integrator == Integrator::DIRECT
+                   || integrator == Integrator::INSTANT_RADIOSITY) {
+          L = traceDirect(r, rng, &features);
+        } else if (integrator == Integrator::AMBIENT_OCCLUSION
+                   || integrator == Integrator::ALBEDO) {
+          L = tracePreview(r, rng, &features);
+        } else {
+          // Only adjoint-driven Russian Roulette needs the pixel's value.
+          float pixelLuminance = adjointRussianRoulette
+            ? math::luminance(img.pixelEstimate(x, y))
+            : 0.0f;
+          L = trace(r, rng, pixelLuminance, &features);
+        }
+        img.setSample(x, y, posX, posY, samp, L, features);
+      }
+    }
+  }
+}
+
+void Camera::renderWorkFunc(int task_index, void* data) {
+  Camera* c = reinterpret_cast<Camera*>(data);
+
+  size_t idx;
+  while (c->tiles.next(task_index, &idx)) {
+    c->renderTile(idx);
+    c->tiles.finish();
   }
 }
 
@@ -1,16 +1,53 @@
 #pragma once
+#include <atomic>
 #include <vector>
+#include <memory>
+#include <unordered_map>
 #include "core.h"
 #include "geom.h"
 #include "image.h"
+#include "infinite_light.h"
+#include "integrators/all.h"
 #include "node.h"
 #include "linear_time.h"
-#include "sdk_util/thread_pool.h"
+#include "alias_table.h"
+#include "light_tree.h"
+#include "lights/distant.h"
+#include "material.h"
+#include "material_table.h"
+#include "radiance_cache.h"
+#include "render_pool.h"
+#include "sd_tree.h"
+#include "shading_context.h"
+#include "tile_scheduler.h"
 
 /**
  * Manages rendering by simulating the action of a physical pinhole camera.
+ * Path tracing and the previews are done by the camera itself; the other
+ * integrators are in integrators/, and share the camera's scene, lights and
+ * film.
  */
 class Camera {
+  friend class integrators::Bidirectional;
+  friend class integrators::InstantRadiosity;
+  friend class integrators::Metropolis;
+  friend class integrators::PhotonMapping;
+
+public:
+  /** The algorithms that the camera can render with. */
+  enum class Integrator {
+    PATH, /**< Path tracing with next event estimation. */
+    BIDIRECTIONAL, /**< Bidirectional path tracing. */
+    PHOTON_MAPPING, /**< Progressive photon mapping. */
+    METROPOLIS, /**< Primary sample space Metropolis light transport. */
+    AMBIENT_OCCLUSION, /**< A preview of the unoccluded fraction of sky. */
+    DIRECT, /**< A preview of direct lighting only. */
+    ALBEDO, /**< A preview of flat colors, shaded by facing ratio. */
+    /** A preview of global illumination from virtual point lights. */
+    INSTANT_RADIOSITY
+  };
+
+private:
   /**
    * The number of bounces at which a ray is subject to Russian Roulette
    * termination, stage 1 (less aggressive).
@@ -21,89 +58,588 @@ class Camera {
    * termination, stage 2 (more aggressive).
    */
   static constexpr int RUSSIAN_ROULETTE_DEPTH_2 = 50;
+  /**
+   * The ratio between the largest and smallest expected contribution, in
+   * proportion to the pixel, that is left alone by adjoint-driven Russian
+   * Roulette and splitting. The window is centered on the pixel's value.
+   */
+  static constexpr float ADJOINT_WINDOW_SIZE = 5.0f;
+  /**
+   * The lowest probability with which adjoint-driven Russian Roulette lets
+   * a path live, so that paths still reach light that the cache missed.
+   */
+  static constexpr float ADJOINT_MIN_SURVIVAL = 0.05f;
+  /** The most continuations that a vertex can be split into. */
+  static constexpr int MAX_SPLITS = 8;
   /**
    * Limits any given sample to the given amount of radiance. This helps to
    * reduce "fireflies" in the output. The lower this value, the more bias will
-   * be introduced into the image. For unbiased rendering, set this to
-   * std::numeric_limits<float>::max().
+   * be introduced into the image. For unbiased rendering, turn clamping off
+   * in the scene.
    */
   static constexpr float BIASED_RADIANCE_CLAMPING = 50.0f;
 
-  static constexpr int MAX_THREADS = 4;
+  /**
+   * The number of emitters at which direct illumination switches from
+   * choosing lights by power alone to choosing them with the light tree,
+   * which also accounts for the distance and orientation of each light.
+   */
+  static constexpr size_t LIGHT_TREE_MIN_EMITTERS = 8;
+
+  /**
+   * The probability of continuing a path in a direction drawn from the
+   * guiding tree rather than from the material, wherever the tree has learned
+   * something. Set this to 0 to disable path guiding.
+   */
+  static constexpr float GUIDING_PROBABILITY = 0.5f;
+
+  /** The number of vertices per path that record light into the tree. */
+  static constexpr int MAX_GUIDING_RECORDS = 16;
+
+  /**
+   * The state that a path carries from one vertex to the next, so that
+   * split paths can continue from where they were split.
+   */
+  struct PathState {
+    int depth; /**< The number of bounces so far. */
+    int diffuseBounces; /**< The number of diffuse bounces so far. */
+    /** Whether the previous vertex sampled the lights directly. */
+    bool didDirectIlluminate;
+    Intersection prevIsect; /**< The previous vertex. */
+    /** The probability of the ray leaving the previous vertex. */
+    float scatterPdf;
+    /** Whether Russian Roulette was already played on the ray. */
+    bool windowed;
+    bool training; /**< Whether the path ignores the radiance cache. */
+  };
+
+  /**
+   * The choices that a path tracing kernel is compiled for, so that it does
+   * not test them at every bounce.
+   */
+  template<bool DIRECT, bool CLAMP, bool SPECULAR>
+  struct TracePolicy {
+    /** Whether diffuse surfaces sample the lights directly. */
+    static constexpr bool directLighting = DIRECT;
+    /** Whether paths are clamped to BIASED_RADIANCE_CLAMPING. */
+    static constexpr bool clamping = CLAMP;
+    /** Whether the scene has materials that are not lit directly. */
+    static constexpr bool specular = SPECULAR;
+  };
+
+  /** A path tracing kernel; see Camera::trace. */
+  typedef Vec (Camera::*TraceKernel)(
+    LightRay r,
+    Randomness& rng,
+    float pixelLuminance,
+    Image::Features* featuresOut
+  ) const;
+
+  /**
+   * A path vertex whose incoming light is recorded into the guiding tree and
+   * the radiance cache when the path ends.
+   */
+  struct GuidingRecord {
+    Vec position; /**< The position of the vertex. */
+    Vec normal; /**< The surface normal, facing the incoming ray. */
+    Vec direction; /**< The direction in which the path continued. */
+    Vec throughput; /**< The path throughput after the vertex. */
+    Vec radianceBefore; /**< The radiance gathered before the vertex. */
+    float pdf; /**< The probability of the continuation direction. */
+  };
+
+  /**
+   * The size of a radiance cache cell as seen from the camera, in pixels on
+   * the focal plane.
+   */
+  static constexpr float RADIANCE_CACHE_CELL_PIXELS = 8.0f;
+  /**
+   * The probability that a path ignores the radiance cache and is traced to
+   * the end, so that the cache keeps learning where it is already used.
+   */
+  static constexpr float RADIANCE_CACHE_TRAINING_PROBABILITY = 0.1f;
+
+  /**
+   * The maximum number of bounces of a photon, or of a ray traced to the
+   * first diffuse surface.
+   */
+  static constexpr int MAX_PHOTON_DEPTH = 16;
+
+  /** The number of rays traced per sample by the ambient occlusion preview. */
+  static constexpr int AMBIENT_OCCLUSION_RAYS = 4;
+  /**
+   * The distance within which the ambient occlusion preview counts
+   * occluders, as a fraction of the focal length.
+   */
+  static constexpr float AMBIENT_OCCLUSION_DISTANCE = 0.1f;
+
+  Integrator integrator; /**< The algorithm used to render. */
+  /**
+   * The algorithm to render with from the next iteration on, which may be
+   * set from any thread.
+   */
+  std::atomic<Integrator> requestedIntegrator;
 
   LinearTime accel; /**< The accelerator containing renderable geometry. */
+  /** Maps each object to render to its ID, counting from 1. */
+  std::unordered_map<const Geom*, int> objectIds;
+  /** The materials of the objects, for evaluating many directions at once. */
+  MaterialTable materials;
   std::vector<const Geom*> emitters; /**< List of all light emitters. */
+  /** Maps each emitter to its index in Camera::emitters. */
+  std::unordered_map<const Geom*, size_t> emitterIndices;
+  AliasTable emitterDistribution; /**< Power-weighted choice of emitters. */
+  LightTree emitterTree; /**< Spatially-aware choice of many emitters. */
+  /** Lights at infinity, seen by rays that escape the scene. */
+  std::vector<const InfiniteLight*> infiniteLights;
+  /** Distant lights that replaced far-away emitters, owned by the camera. */
+  std::vector<std::unique_ptr<const lights::Distant>> distantLights;
+  /**
+   * The environment with the distant lights in front of it, if there are
+   * any, in place of the scene's environment.
+   */
+  std::unique_ptr<const InfiniteLight> occludedEnvironment;
+  /**
+   * Power-weighted choice between the emitters as a whole (index 0) and each
+   * of the infinite lights (index i + 1 for infiniteLights[i]).
+   */
+  AliasTable lightGroupDistribution;
+  /**
+   * Learns where light arrives from, to guide paths towards it. It is
+   * recorded into while tracing and refined between iterations.
+   */
+  mutable SDTree guidingTree;
+  /**
+   * Learns the light arriving at diffuse surfaces, so that paths can end at
+   * their second diffuse bounce and so that Russian Roulette knows what they
+   * would find. It is recorded into while tracing and updated between
+   * iterations, and has no cells unless it is used.
+   */
+  mutable RadianceCache radianceCache;
+  /**
+   * Whether paths end early in the radiance cache. Otherwise, the cache may
+   * still learn to guide Russian Roulette and splitting.
+   */
+  const bool useRadianceCache;
+  /** Whether the radiance of each sample is clamped. */
+  const bool clampRadiance;
+  /**
+   * Whether path tracing decides how many continuations each diffuse vertex
+   * gets from how much they are expected to contribute to the pixel, as
+   * learned by the radiance cache, instead of from the path's depth and
+   * throughput alone. Continuations expected to matter little are killed
+   * by Russian Roulette, and ones expected to matter a lot are split. This
+   * pays off when importance varies sharply across the scene; otherwise,
+   * keeping the cache learning costs about as much as it saves.
+   */
+  const bool adjointRussianRoulette;
+  /**
+   * The number of candidate light samples that direct illumination chooses
+   * between by their unshadowed contribution, before tracing a single shadow
+   * ray. Each candidate costs about as much as a shadow ray through a small
+   * scene, so this only pays off when shadow rays are expensive; 1 disables
+   * resampling.
+   */
+  const int lightCandidates;
+  /** The path tracing kernel compiled for the scene and its options. */
+  TraceKernel traceKernel;
+
+  BSphere sceneBounds; /**< The bounds of the renderable geometry. */
+
+  /** Hands out the tiles of each iteration to the worker threads. */
+  TileScheduler tiles;
+
+  /** The bidirectional path tracer. */
+  integrators::Bidirectional bidirectional;
+  /** The photon mapper, whose photons are gathered by Camera::traceDirect. */
+  integrators::PhotonMapping photonMapping;
+  /** The virtual lights gathered by Camera::traceDirect. */
+  integrators::InstantRadiosity instantRadiosity;
+  /** The Metropolis integrator, with one Markov chain per tile. */
+  integrators::Metropolis metropolis;
 
   const float focalLength; /**< The distance from the eye to the focal plane. */
   const float lensRadius; /**< The radius of the lens opening. */
   const Transform camToWorldXform; /**< Transform from camera to world space. */
+  const Transform worldToCamXform; /**< Transform from world to camera space. */
 
   float focalPlaneUp; /**< The height of the focal plane. */
   float focalPlaneRight; /**< The width of the focal plane. */
   Vec focalPlaneOrigin; /**< The origin (corner) of the focal plane. */
 
-  Randomness masterRng; /**< The RNG used to seed the per-row RNGs. */
-  std::vector<unsigned> rowSeeds; /**< The per-row RNG seeds. */
+  Randomness masterRng; /**< The RNG used to seed the per-tile RNGs. */
+  std::vector<unsigned> tileSeeds; /**< The per-tile RNG seeds. */
 
   Image img; /**< The rendered and filtered image. */
+  /** The number of iterations between denoising passes; 0 never denoises. */
+  const int denoiseInterval;
 
   int iters; /** The current number of path-tracing iterations done. */
 
-  sdk_util::ThreadPool pool;
+  RenderPool& pool; /**< The threads shared by every camera. */
+
+  /**
+   * Replaces emitters that are so far away that they look the same from
+   * everywhere in the scene with distant lights, which can be sampled
+   * exactly and never need to be intersected. The new lights are added to
+   * Camera::distantLights and Camera::infiniteLights.
+   *
+   * @param objs the objects to render
+   * @returns    the objects to render, without the replaced emitters
+   */
+  std::vector<const Geom*> promoteDistantEmitters(
+    const std::vector<const Geom*>& objs
+  );
 
   /**
    * Traces a path starting with the given ray, and returns the sampled
    * radiance.
    *
-   * @param r   the ray that starts the path
-   * @param rng the per-thread RNG in use
-   * @returns   the sampled radiance of the path
+   * @param r                  the ray that starts the path
+   * @param rng                the per-thread RNG in use
+   * @param pixelLuminance     the luminance of the pixel so far, which
+   *                            guides Russian Roulette and splitting; 0 if
+   *                            unknown
+   * @param featuresOut  [out]  if not null, the features of the first
+   *                            non-specular surface along the path
+   * @returns                   the sampled radiance of the path
    */
   Vec trace(
     LightRay r,
-    Randomness& rng
+    Randomness& rng,
+    float pixelLuminance = 0.0f,
+    Image::Features* featuresOut = nullptr
+  ) const;
+
+  /**
+   * Same as Camera::trace, compiled for the given policy.
+   */
+  template<typename Policy>
+  Vec traceWith(
+    LightRay r,
+    Randomness& rng,
+    float pixelLuminance,
+    Image::Features* featuresOut
+  ) const;
+
+  /**
+   * Returns the kernel compiled for the given choices.
+   *
+   * @param direct   whether diffuse surfaces sample the lights directly
+   * @param clamp    whether paths are clamped
+   * @param specular whether the scene has materials that are not lit
+   *                 directly
+   * @returns        the kernel
+   */
+  static TraceKernel selectTraceKernel(bool direct, bool clamp, bool specular);
+
+  /**
+   * Continues a path from the given state, and returns the radiance that it
+   * gathers from there on, without clamping. Same as Camera::trace
+   * otherwise.
+   */
+  template<typename Policy>
+  Vec tracePath(
+    LightRay r,
+    Randomness& rng,
+    float pixelLuminance,
+    const PathState& start,
+    Image::Features* featuresOut
+  ) const;
+
+  /**
+   * Records the light that arrived at a path vertex into the guiding tree
+   * and the radiance cache.
+   *
+   * @param rec           the vertex
+   * @param radianceAfter the radiance gathered by the path once it had
+   *                      continued from the vertex
+   * @param guided        whether to record into the guiding tree
+   * @param cached        whether to record into the radiance cache
+   */
+  void recordVertex(
+    const GuidingRecord& rec,
+    const Vec& radianceAfter,
+    bool guided,
+    bool cached
+  ) const;
+
+  /**
+   * Traces a path starting with the given ray through specular bounces, and
+   * estimates the radiance at the first diffuse surface it reaches from the
+   * lights directly. Depending on the integrator, everything else is gathered
+   * from the photon map or from the virtual lights, or left out.
+   *
+   * @param r                  the ray that starts the path
+   * @param rng                the per-thread RNG in use
+   * @param featuresOut  [out]  if not null, the features of the first
+   *                            non-specular surface along the path
+   * @returns                   the sampled radiance of the path
+   */
+  Vec traceDirect(
+    LightRay r,
+    Randomness& rng,
+    Image::Features* featuresOut = nullptr
+  ) const;
+
+  /**
+   * Shades the first surface that the given ray hits for a preview, with
+   * ambient occlusion or with its flat color, depending on the integrator.
+   *
+   * @param r                  the ray to shade
+   * @param rng                the per-thread RNG in use
+   * @param featuresOut  [out]  if not null, the features of the surface
+   * @returns                   the preview color
+   */
+  Vec tracePreview(
+    const LightRay& r,
+    Randomness& rng,
+    Image::Features* featuresOut = nullptr
+  ) const;
+
+  /**
+   * Discards everything rendered and learned by the current integrator, so
+   * that rendering starts over.
+   */
+  void restart();
+
+  /**
+   * Records the features of the given surface for the denoiser and the
+   * image's outputs, if they are wanted and this is the first non-specular
+   * surface along the path. Once they are recorded, the output pointer is
+   * cleared.
+   *
+   * @param g                     the surface that was hit
+   * @param isect                 the intersection on the surface
+   * @param depth                 the length of the path up to the surface
+   * @param featuresOut  [in,out]  the features to fill in, or null
+   */
+  void recordFeatures(
+    const Geom* g,
+    const Intersection& isect,
+    float depth,
+    Image::Features** featuresOut
   ) const;
 
   /**
-   * Randomly picks a light and samples it for direct illumination. The
-   * radiance returned will be scaled according to the probability of picking
-   * the light.
+   * Samples a ray leaving a light chosen in proportion to its power, carrying
+   * the power of the light divided by the probability of the ray.
    *
    * @param rng         the per-thread RNG in use
-   * @param incoming    the ray coming into the intersection on the target
-   *                    geometry (on the reflector)
-   * @param isect       the intersection on the target geometry that should be
-   *                    illuminated
-   * @param mat         the material of the target geometry being illuminated
+   * @param rayOut [out] the sampled ray
+   * @returns           false if there are no lights to sample
+   */
+  bool sampleLightRay(Randomness& rng, LightRay* rayOut) const;
+
+  /**
+   * Follows a light path from a ray sampled by Camera::sampleLightRay, and
+   * calls the given function at each diffuse surface that the path reaches.
+   *
+   * @param rng   the per-thread RNG in use
+   * @param visit the function to call with the ray arriving at each surface,
+   *              the intersection, the material of the surface, and the
+   *              number of bounces before it
+   */
+  template<typename Func>
+  void traceLightPath(Randomness& rng, Func visit) const;
+
+  /**
+   * Generates a ray from the lens through the given position on the film.
+   *
+   * @param rng  the per-thread RNG in use, used to sample the lens
+   * @param posX the x-position on the film, in pixels
+   * @param posY the y-position on the film, in pixels
+   * @returns    the camera ray, in world space
+   */
+  LightRay cameraRay(Randomness& rng, float posX, float posY) const;
+
+  /**
+   * Renders the samples of every pixel in a tile for the current iteration.
+   *
+   * @param idx the index of the tile in Camera::tiles
+   */
+  void renderTile(size_t idx);
+
+  /**
+   * Returns the probability, with respect to solid angle, that a camera ray
+   * would be traced in the given direction. This assumes that one light
+   * subpath is traced for every camera ray, and that light subpaths reach the
+   * whole film.
+   */
+  float cameraPdfDir(const Vec& dir) const;
+
+  /**
+   * Finds where a ray leaving the lens passes through the film.
+   *
+   * @param lensPoint     the point on the lens, in world space
+   * @param dir           the direction of the ray, in world space
+   * @param posXOut [out] the x-position on the film, in pixels
+   * @param posYOut [out] the y-position on the film, in pixels
+   * @returns             true if the ray passes through the film
+   */
+  bool projectToFilm(
+    const Vec& lensPoint,
+    const Vec& dir,
+    float* posXOut,
+    float* posYOut
+  ) const;
+
+  /** Returns true if the given position, in pixels, is on the film. */
+  bool isOnFilm(float posX, float posY) const;
+
+  /** Returns true if nothing lies between the two given points. */
+  bool unoccluded(const Vec& a, const Vec& b) const;
+
+  /**
+   * Continues a path from the given intersection, sampling either the
+   * material or the guiding tree and weighting by the combined probability
+   * of both (one-sample MIS with the balance heuristic).
+   *
+   * @param rng          the per-thread RNG in use
+   * @param incoming     the ray that struck the surface
+   * @param ctx          the shading context of the intersection
+   * @param guide        the guiding distribution at the intersection, or null
+   *                     to sample only the material
+   * @param pdfOut [out] the combined probability of the outgoing direction
+   * @returns            the ray continuing the path
    */
-  Vec uniformSampleOneLight(
+  LightRay guidedScatter(
     Randomness& rng,
     const LightRay& incoming,
+    const ShadingContext& ctx,
+    const DTree* guide,
+    float* pdfOut
+  ) const;
+
+  /**
+   * Randomly picks a light, in proportion to its estimated contribution, and
+   * samples it for direct illumination. The radiance returned will be scaled
+   * according to the probability of picking the light.
+   *
+   * @param rng         the per-thread RNG in use
+   * @param ctx         the shading context of the target geometry (the
+   *                    reflector) that should be illuminated
+   * @param guide       the guiding distribution that the path continues from,
+   *                    or null if it only samples the material
+   */
+  Vec sampleOneLight(
+    Randomness& rng,
+    const ShadingContext& ctx,
+    const DTree* guide
+  ) const;
+
+  /**
+   * Picks a light as Camera::sampleOneLight does and samples a direction
+   * towards it, ignoring occlusion.
+   *
+   * @param rng            the per-thread RNG in use
+   * @param isect          the intersection being illuminated
+   * @param dirOut   [out] the direction from the intersection to the light
+   * @param colorOut [out] the radiance arriving from the light
+   * @param pdfOut   [out] the probability of the direction, including the
+   *                       choice of light, as in Camera::sampleOneLightPDF
+   * @param distOut  [out] the distance to the light, or math::VERY_BIG for a
+   *                       light at infinity
+   */
+  void sampleUnoccludedLight(
+    Randomness& rng,
+    const Intersection& isect,
+    Vec* dirOut,
+    Vec* colorOut,
+    float* pdfOut,
+    float* distOut
+  ) const;
+
+  /**
+   * Samples direct illumination with resampled importance sampling: draws
+   * Camera::lightCandidates light samples, keeps one in proportion
+   * to its unshadowed contribution, and only traces a shadow ray to that
+   * one. Like Camera::sampleOneLight, the result is weighted against the
+   * material sampling strategy.
+   *
+   * See Talbot et al., "Importance Resampling for Global Illumination"
+   * (2005).
+   *
+   * @param rng         the per-thread RNG in use
+   * @param ctx         the shading context of the target geometry (the
+   *                    reflector) that should be illuminated
+   * @param guide       the guiding distribution that the path continues from,
+   *                    or null if it only samples the material
+   */
+  Vec resampleOneLight(
+    Randomness& rng,
+    const ShadingContext& ctx,
+    const DTree* guide
+  ) const;
+
+  /**
+   * Returns the probability that Camera::sampleOneLight would pick the given
+   * emitter and then sample the given direction towards it, with respect to
+   * solid angle.
+   *
+   * @param isect   the intersection on the geometry being illuminated
+   * @param emitter the emitter
+   * @param dir     the direction from the intersection towards the emitter
+   */
+  float sampleOneLightPDF(
     const Intersection& isect,
-    const Material* mat
+    const Geom* emitter,
+    const Vec& dir
   ) const;
 
+  /**
+   * Returns the probability that Camera::sampleOneLight would pick the given
+   * infinite light and then sample the given direction towards it, with
+   * respect to solid angle.
+   *
+   * @param lightIdx the index of the light in Camera::infiniteLights
+   * @param dir      the direction towards the light
+   */
+  float sampleOneLightPDF(size_t lightIdx, const Vec& dir) const;
+
 public:
   /**
    * Constructs a camera.
    *
    * @param xform  the transformation from camera space to world space
    * @param objs   the objects to render
+   * @param env    the environment light surrounding the objects, or null if
+   *               rays escaping the scene should see only black
    * @param ww     the width of the output image, in pixels
    * @param hh     the height of the output image, in pixels
    * @param fov    the field of view (horizontal or vertical, whichever is
    *               smaller), in radians
    * @param len    the focal length of the lens
-   * @param fStop the f-stop (aperture) of the lens
+   * @param fStop  the f-stop (aperture) of the lens
+   * @param integ  the algorithm to render with
+   * @param dn     the number of iterations between denoising the image, or 0
+   *               to never denoise it
+   * @param cache  whether path tracing ends paths early using a radiance
+   *               cache, trading some bias for speed
+   * @param direct whether path tracing samples the lights directly
+   * @param clamp  whether the radiance of each sample is clamped, trading
+   *               some bias for fewer fireflies
+   * @param adj    whether path tracing plays Russian Roulette and splits
+   *               paths by their expected contribution to the pixel
+   * @param lc     the number of candidate light samples that each direct
+   *               light sample is resampled from; 1 disables resampling
    */
   Camera(
     const Transform& xform,
     const std::vector<const Geom*>& objs,
+    const InfiniteLight* env,
     long ww,
     long hh,
     float fov = math::PI_4,
     float len = 50.0f,
-    float fStop = 16.0f
+    float fStop = 16.0f,
+    Integrator integ = Integrator::PATH,
+    int dn = 0,
+    bool cache = false,
+    bool direct = true,
+    bool clamp = true,
+    bool adj = false,
+    int lc = 1
   );
 
   /**
@@ -111,6 +647,19 @@ public:
    */
    Camera(const Node& n);
 
+  /**
+   * Returns the integrator with the given name, which is "path", "bdpt",
+   * "ppm", "mlt", "ao", "direct", "albedo", or "vpl".
+   */
+  static Integrator integratorFromName(const std::string& name);
+
+  /**
+   * Switches to the given integrator from the next iteration on, starting
+   * the image over. This may be called from any thread, e.g. while the
+   * camera renders.
+   */
+  void setIntegrator(Integrator integ);
+
   /**
    * Renders an additional iteration of the image by path-tracing.
    * If there are existing iterations, the additional iteration will be
@@ -120,6 +669,13 @@ public:
    */
   void renderOnce(std::atomic<bool>& needsUpdate);
 
+  /**
+   * Returns the fraction of the current iteration that has been rendered,
+   * in [0, 1]. This may be called from any thread, e.g. while the camera
+   * renders.
+   */
+  float iterationProgress() const;
+
   /**
    * Renders multiple additional path-tracing iterations.
    * To render infinite iterations, specify iterations = -1.
@@ -134,3 +690,28 @@ public:
 
   static void renderWorkFunc(int task_index, void* data);
 };
+
+template<typename Func>
+void Camera::traceLightPath(Randomness& rng, Func visit) const {
+  LightRay r;
+  if (!sampleLightRay(rng, &r)) {
+    return;
+  }
+
+  for (int depth = 0; depth < MAX_PHOTON_DEPTH; ++depth) {
+    Intersection isect;
+    const Geom* g = accel.intersect(r, &isect);
+    if (!g || !g->mat) {
+      break;
+    }
+
+    if (g->mat->shouldDirectIlluminate()) {
+      visit(r, isect, g->mat, depth);
+    }
+
+    r = g->mat->scatter(rng, r, isect);
+    if (r.isBlack()) {
+      break;
+    }
+  }
+}
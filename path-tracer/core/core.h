@@ -85,7 +85,7 @@ struct LightRay : public Ray {
    * Returns the perceived luminance of the light's color, assuming it is RGB.
    */
   inline float luminance() const {
-    return 0.21f * color.x() + 0.71f * color.y() + 0.08f * color.z();
+    return math::luminance(color);
   }
 
   /**
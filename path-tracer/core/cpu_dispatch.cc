@@ -0,0 +1,39 @@
+#include "cpu_dispatch.h"
+
+namespace {
+
+  /** Queries CPUID for the widest supported instruction set. */
+  cpu::InstructionSet detectInstructionSet() {
+#if CPU_DISPATCH
+    // Also checks that the OS saves the wider registers.
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")
+        && __builtin_cpu_supports("avx512vl")
+        && __builtin_cpu_supports("avx512dq")) {
+      return cpu::InstructionSet::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+      return cpu::InstructionSet::AVX2;
+    }
+#endif
+    return cpu::InstructionSet::GENERIC;
+  }
+
+}
+
+cpu::InstructionSet cpu::instructionSet() {
+  static const InstructionSet detected = detectInstructionSet();
+  return detected;
+}
+
+const char* cpu::instructionSetName(InstructionSet isa) {
+  switch (isa) {
+    case InstructionSet::GENERIC:
+      return "generic";
+    case InstructionSet::AVX2:
+      return "avx2";
+    case InstructionSet::AVX512:
+      return "avx512";
+  }
+  return "unknown";
+}
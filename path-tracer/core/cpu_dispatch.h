@@ -0,0 +1,74 @@
+#pragma once
+
+/**
+ * Runtime selection between copies of the hot kernels compiled for
+ * different instruction sets, so that one binary uses the widest vectors
+ * that the CPU it runs on supports.
+ *
+ * A kernel is written once as a CPU_KERNEL function. Thin wrappers then
+ * compile it again under CPU_TARGET_AVX2 and CPU_TARGET_AVX512, and the
+ * caller picks a wrapper with cpu::instructionSet(). Where the compiler
+ * cannot target x86 extensions per function (including Native Client, whose
+ * validator only accepts the baseline), every wrapper is the generic one.
+ */
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) \
+    && !defined(__native_client__)
+#define CPU_DISPATCH 1
+/**
+ * Forces a kernel into each wrapper that calls it, since the compiler would
+ * otherwise share one baseline copy between them.
+ */
+#define CPU_KERNEL inline __attribute__((always_inline))
+/** Compiles a function for AVX2 with fused multiply-add. */
+#define CPU_TARGET_AVX2 __attribute__((target("avx2,fma")))
+/** Compiles a function for the AVX-512 foundation and vector lengths. */
+#define CPU_TARGET_AVX512 \
+  __attribute__((target("avx512f,avx512vl,avx512dq,avx2,fma")))
+#else
+#define CPU_DISPATCH 0
+#define CPU_KERNEL inline
+#define CPU_TARGET_AVX2
+#define CPU_TARGET_AVX512
+#endif
+
+namespace cpu {
+
+  /** The instruction sets that kernels are compiled for. */
+  enum class InstructionSet {
+    GENERIC, /**< The baseline of the target architecture. */
+    AVX2, /**< AVX2 and FMA. */
+    AVX512 /**< AVX-512F, VL and DQ, in addition to AVX2. */
+  };
+
+  /**
+   * Returns the widest instruction set that both this CPU (as reported by
+   * CPUID) and the build support. Detected once, on the first call.
+   */
+  InstructionSet instructionSet();
+
+  /** Returns a short, lowercase name for the given instruction set. */
+  const char* instructionSetName(InstructionSet isa);
+
+  /**
+   * Picks the kernel compiled for the instruction set in use.
+   *
+   * @param generic the kernel compiled for the baseline
+   * @param avx2    the kernel compiled with CPU_TARGET_AVX2
+   * @param avx512  the kernel compiled with CPU_TARGET_AVX512
+   * @returns       the kernel to call
+   */
+  template<typename Kernel>
+  inline Kernel select(Kernel generic, Kernel avx2, Kernel avx512) {
+    switch (instructionSet()) {
+      case InstructionSet::AVX512:
+        return avx512;
+      case InstructionSet::AVX2:
+        return avx2;
+      case InstructionSet::GENERIC:
+        break;
+    }
+    return generic;
+  }
+
+}
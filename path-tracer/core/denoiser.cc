@@ -0,0 +1,91 @@
+#include "denoiser.h"
+#include "render_pool.h"
+
+Denoiser::Denoiser(long ww, long hh)
+  : color(size_t(ww * hh), Vec4(0, 0, 0, 0)),
+    filtered(size_t(ww * hh), Vec4(0, 0, 0, 0)),
+    albedo(size_t(ww * hh), Vec4(0, 0, 0, 0)),
+    normalDepth(size_t(ww * hh), Vec4(0, 0, 0, 0)),
+    step(1), colorScale(1.0f), w(ww), h(hh) {}
+
+void Denoiser::setPixel(
+  long x,
+  long y,
+  const Vec& c,
+  const Vec& a,
+  const Vec& n,
+  float depth
+) {
+  size_t idx = size_t(y * w + x);
+  color[idx] = Vec4(c.x(), c.y(), c.z(), 0.0f);
+  albedo[idx] = Vec4(a.x(), a.y(), a.z(), 0.0f);
+  normalDepth[idx] = Vec4(n.x(), n.y(), n.z(), depth);
+}
+
+void Denoiser::denoise(RenderPool* pool) {
+  float colorSigma = COLOR_SIGMA;
+  for (int pass = 0; pass < PASSES; ++pass) {
+    step = 1 << pass;
+    colorScale = 1.0f / (colorSigma * colorSigma);
+    pool->dispatch(int(h), &Denoiser::rowWorkFunc, this);
+
+    color.swap(filtered);
+    colorSigma *= 0.5f;
+  }
+}
+
+void Denoiser::filterRow(long y) {
+  // The B3-spline kernel, indexed by the distance from the center tap.
+  static const float kernel[3] = { 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+  const float normalScale = 1.0f / (NORMAL_SIGMA * NORMAL_SIGMA);
+  const float albedoScale = 1.0f / (ALBEDO_SIGMA * ALBEDO_SIGMA);
+
+  for (long x = 0; x < w; ++x) {
+    size_t idx = size_t(y * w + x);
+    const Vec4 c = color[idx];
+    const Vec4 a = albedo[idx];
+    const Vec4 nd = normalDepth[idx];
+    const float depthScale = nd.w() > 0.0f
+      ? 1.0f / (DEPTH_SIGMA * DEPTH_SIGMA * nd.w() * nd.w())
+      : 0.0f;
+
+    Vec4 sum(0, 0, 0, 0);
+    float weightSum = 0.0f;
+    for (int dy = -2; dy <= 2; ++dy) {
+      long yy = y + dy * step;
+      if (yy < 0 || yy >= h) {
+        continue;
+      }
+
+      for (int dx = -2; dx <= 2; ++dx) {
+        long xx = x + dx * step;
+        if (xx < 0 || xx >= w) {
+          continue;
+        }
+
+        size_t tap = size_t(yy * w + xx);
+        const Vec4 ct = color[tap];
+        Vec4 ndDiff = normalDepth[tap] - nd;
+        float depthDiff = ndDiff.w();
+        ndDiff.w() = 0.0f;
+
+        float exponent = (ct - c).squaredNorm() * colorScale
+          + ndDiff.squaredNorm() * normalScale
+          + (albedo[tap] - a).squaredNorm() * albedoScale
+          + depthDiff * depthDiff * depthScale;
+        float weight = kernel[abs(dx)] * kernel[abs(dy)] * expf(-exponent);
+
+        sum += ct * weight;
+        weightSum += weight;
+      }
+    }
+
+    // The center tap always has a positive weight.
+    filtered[idx] = sum / weightSum;
+  }
+}
+
+void Denoiser::rowWorkFunc(int task_index, void* data) {
+  Denoiser* d = reinterpret_cast<Denoiser*>(data);
+  d->filterRow(task_index);
+}
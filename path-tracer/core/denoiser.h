@@ -0,0 +1,92 @@
+#pragma once
+#include <vector>
+#include "math.h"
+
+class RenderPool;
+
+/**
+ * An edge-avoiding a-trous wavelet filter that smooths away the noise in a
+ * rendered image while keeping the edges found in its feature buffers. Each
+ * pass blurs with a 5x5 B3-spline kernel whose taps are spread twice as far
+ * apart as in the previous pass, and each tap is weighted down by how much
+ * its color, albedo, normal, and depth differ from the center pixel's.
+ *
+ * The buffers hold Vec4s so that the per-tap differences are computed with
+ * packed SIMD arithmetic, and each pass filters the rows in parallel.
+ *
+ * See Dammertz et al., "Edge-Avoiding A-Trous Wavelet Transform for Fast
+ * Global Illumination Filtering" (HPG 2010).
+ */
+class Denoiser {
+  /** A row-major image, aligned for SIMD access. */
+  typedef std::vector<Vec4, Eigen::aligned_allocator<Vec4>> Buffer;
+
+  Buffer color; /**< The input of the current pass. */
+  Buffer filtered; /**< The output of the current pass. */
+  Buffer albedo; /**< The albedo of each pixel (w unused). */
+  Buffer normalDepth; /**< The normal (xyz) and depth (w) of each pixel. */
+
+  int step; /**< The spacing between taps in the current pass. */
+  float colorScale; /**< The inverse variance of colors in the current pass. */
+
+  /**
+   * Filters one row of the current pass.
+   */
+  void filterRow(long y);
+
+  static void rowWorkFunc(int task_index, void* data);
+
+public:
+  /** The number of filter passes; the last one has taps 2^(PASSES-1) apart. */
+  static constexpr int PASSES = 5;
+  /**
+   * How far apart colors may be before they stop being blended. This halves
+   * with each pass, since later passes see less noise.
+   */
+  static constexpr float COLOR_SIGMA = 1.0f;
+  /** How far apart normals may be before they stop being blended. */
+  static constexpr float NORMAL_SIGMA = 0.3f;
+  /** How far apart albedos may be before they stop being blended. */
+  static constexpr float ALBEDO_SIGMA = 0.1f;
+  /** How far apart depths may be, relative to the center pixel's depth. */
+  static constexpr float DEPTH_SIGMA = 0.05f;
+
+  const long w; /**< The width of the image. */
+  const long h; /**< The height of the image. */
+
+  /**
+   * Constructs a denoiser for images of the given size.
+   */
+  Denoiser(long ww, long hh);
+
+  /**
+   * Sets the noisy color and the features of the given pixel.
+   *
+   * @param x      the x-coordinate of the pixel
+   * @param y      the y-coordinate of the pixel
+   * @param c      the color of the pixel
+   * @param a      the albedo of the first diffuse surface in the pixel
+   * @param n      the normal of the first diffuse surface in the pixel
+   * @param depth  the distance to the first diffuse surface in the pixel
+   */
+  void setPixel(
+    long x,
+    long y,
+    const Vec& c,
+    const Vec& a,
+    const Vec& n,
+    float depth
+  );
+
+  /**
+   * Filters the colors that were set, using the given threads.
+   */
+  void denoise(RenderPool* pool);
+
+  /**
+   * Returns the filtered color of the given pixel.
+   */
+  inline Vec result(long x, long y) const {
+    return color[size_t(y * w + x)].head<3>();
+  }
+};
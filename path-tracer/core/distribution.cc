@@ -0,0 +1,103 @@
+#include "distribution.h"
+#include <algorithm>
+
+Distribution1D::Distribution1D(const float* f, size_t n)
+  : func(f, f + n), cdf(n + 1), funcInt(0.0f)
+{
+  for (float& x : func) {
+    x = fabsf(x);
+  }
+
+  // Integrate the step function to get the (unnormalized) CDF.
+  cdf[0] = 0.0f;
+  for (size_t i = 1; i < n + 1; ++i) {
+    cdf[i] = cdf[i - 1] + func[i - 1] / float(n);
+  }
+
+  // Normalize, or fall back to a uniform distribution for a zero function.
+  funcInt = cdf[n];
+  if (funcInt == 0.0f) {
+    for (size_t i = 1; i < n + 1; ++i) {
+      cdf[i] = float(i) / float(n);
+    }
+  } else {
+    for (size_t i = 1; i < n + 1; ++i) {
+      cdf[i] /= funcInt;
+    }
+  }
+}
+
+float Distribution1D::sampleContinuous(
+  float u,
+  float* pdfOut,
+  size_t* offsetOut
+) const {
+  // Find the last CDF entry that is <= u.
+  auto it = std::upper_bound(cdf.begin(), cdf.end(), u);
+  size_t offset = math::clampAny(
+    size_t(std::max(long(it - cdf.begin()) - 1, 0l)),
+    size_t(0),
+    func.size() - 1
+  );
+  if (offsetOut) {
+    *offsetOut = offset;
+  }
+
+  // Find how far u lies within the piece.
+  float du = u - cdf[offset];
+  float width = cdf[offset + 1] - cdf[offset];
+  if (width > 0.0f) {
+    du /= width;
+  }
+
+  *pdfOut = pdf(offset);
+  return (float(offset) + du) / float(count());
+}
+
+std::vector<Distribution1D> Distribution2D::buildRows(
+  const float* f,
+  size_t nu,
+  size_t nv
+) {
+  std::vector<Distribution1D> rows;
+  rows.reserve(nv);
+  for (size_t v = 0; v < nv; ++v) {
+    rows.push_back(Distribution1D(&f[v * nu], nu));
+  }
+  return rows;
+}
+
+std::vector<float> Distribution2D::rowIntegrals(
+  const std::vector<Distribution1D>& rows
+) {
+  std::vector<float> integrals;
+  integrals.reserve(rows.size());
+  for (const Distribution1D& row : rows) {
+    integrals.push_back(row.integral());
+  }
+  return integrals;
+}
+
+Distribution2D::Distribution2D(const float* f, size_t nu, size_t nv)
+  : conditional(buildRows(f, nu, nv)),
+    marginal(rowIntegrals(conditional).data(), nv) {}
+
+Vec2 Distribution2D::sampleContinuous(Randomness& rng, float* pdfOut) const {
+  float pdfs[2];
+  size_t v;
+  float d1 = marginal.sampleContinuous(rng.nextUnitFloat(), &pdfs[1], &v);
+  float d0 =
+    conditional[v].sampleContinuous(rng.nextUnitFloat(), &pdfs[0], nullptr);
+
+  *pdfOut = pdfs[0] * pdfs[1];
+  return Vec2(d0, d1);
+}
+
+float Distribution2D::pdf(const Vec2& p) const {
+  size_t nu = conditional[0].count();
+  size_t nv = marginal.count();
+  size_t iu = math::clampAny(size_t(max(0.0f, p.x()) * nu), size_t(0), nu - 1);
+  size_t iv = math::clampAny(size_t(max(0.0f, p.y()) * nv), size_t(0), nv - 1);
+
+  return conditional[iv].pdf(iu) * marginal.pdf(iv);
+}
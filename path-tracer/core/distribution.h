@@ -0,0 +1,101 @@
+#pragma once
+#include <vector>
+#include "math.h"
+#include "randomness.h"
+
+/**
+ * A piecewise-constant 1D probability distribution over [0, 1), built from a
+ * tabulated function and sampled by inverting its CDF.
+ *
+ * Taken from Pharr & Humphreys section 13.6.
+ */
+class Distribution1D {
+  std::vector<float> func; /**< The (absolute value of the) function. */
+  std::vector<float> cdf; /**< The CDF, with func.size() + 1 entries. */
+  float funcInt; /**< The integral of the function over [0, 1). */
+
+public:
+  /**
+   * Constructs a distribution from the given function values. If the function
+   * is zero everywhere, the distribution is uniform.
+   *
+   * @param f the function values; must not be empty
+   * @param n the number of function values
+   */
+  Distribution1D(const float* f, size_t n);
+
+  /** Returns the number of pieces in the distribution. */
+  inline size_t count() const { return func.size(); }
+
+  /** Returns the integral of the function over [0, 1). */
+  inline float integral() const { return funcInt; }
+
+  /**
+   * Returns the probability density of sampling a value in the given piece.
+   */
+  inline float pdf(size_t offset) const {
+    return funcInt > 0.0f ? func[offset] / funcInt : 1.0f;
+  }
+
+  /**
+   * Samples a value in [0, 1) according to the distribution.
+   *
+   * @param u               a uniform random number in [0, 1)
+   * @param pdfOut    [out] the probability density of the sampled value;
+   *                        the pointer must not be null
+   * @param offsetOut [out] the index of the piece containing the value;
+   *                        may be null if not needed
+   * @returns               the sampled value
+   */
+  float sampleContinuous(float u, float* pdfOut, size_t* offsetOut) const;
+};
+
+/**
+ * A piecewise-constant 2D probability distribution over [0, 1)^2, sampled by
+ * first choosing a row from the marginal distribution and then a column from
+ * that row's conditional distribution.
+ *
+ * Taken from Pharr & Humphreys section 13.6.7.
+ */
+class Distribution2D {
+  std::vector<Distribution1D> conditional; /**< One distribution per row. */
+  Distribution1D marginal; /**< The distribution over rows. */
+
+  /** Helper for building the marginal distribution from the rows. */
+  static std::vector<float> rowIntegrals(
+    const std::vector<Distribution1D>& rows
+  );
+
+  /** Helper for building the conditional distributions from the function. */
+  static std::vector<Distribution1D> buildRows(
+    const float* f,
+    size_t nu,
+    size_t nv
+  );
+
+public:
+  /**
+   * Constructs a distribution from the given function values, stored in
+   * row-major order.
+   *
+   * @param f  the function values; must not be empty
+   * @param nu the number of columns (the first coordinate)
+   * @param nv the number of rows (the second coordinate)
+   */
+  Distribution2D(const float* f, size_t nu, size_t nv);
+
+  /**
+   * Samples a point in [0, 1)^2 according to the distribution.
+   *
+   * @param rng          the per-thread RNG in use
+   * @param pdfOut [out] the probability density of the sampled point;
+   *                     the pointer must not be null
+   * @returns            the sampled point
+   */
+  Vec2 sampleContinuous(Randomness& rng, float* pdfOut) const;
+
+  /**
+   * Returns the probability density of sampling the given point.
+   */
+  float pdf(const Vec2& p) const;
+};
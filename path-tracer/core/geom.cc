@@ -14,3 +14,72 @@ void Geom::refine(std::vector<const Geom*>& refined) const {
 BSphere Geom::boundSphere() const {
   return BSphere(boundBox());
 }
+
+bool Geom::isSpherical() const {
+  return false;
+}
+
+void Geom::boundNormals(Vec* axisOut, float* cosThetaOut) const {
+  *axisOut = Vec(0, 0, 1);
+  *cosThetaOut = -1.0f;
+}
+
+bool Geom::sampleSurface(
+  Randomness& rng,
+  const Vec& point,
+  Vec* positionOut,
+  Vec* normalOut,
+  float* pdfOut
+) const {
+  Vec dir;
+  BSphere bounds = boundSphere();
+  if (bounds.contains(point)) {
+    // We're inside the bounding sphere, so sample sphere uniformly.
+    dir = math::uniformSampleSphere(rng);
+    *pdfOut = math::uniformSampleSpherePDF();
+  } else {
+    // We're outside the bounding sphere, so sample by solid angle.
+    Vec dirToOrigin = bounds.origin - point;
+    float theta = asinf(bounds.radius / dirToOrigin.norm());
+
+    Vec normal = dirToOrigin.normalized();
+    Vec tangent;
+    Vec binormal;
+    math::coordSystem(normal, &tangent, &binormal);
+
+    dir = math::localToWorld(
+      math::uniformSampleCone(rng, theta),
+      tangent,
+      binormal,
+      normal
+    );
+    *pdfOut = math::uniformSampleConePDF(theta);
+  }
+
+  Intersection isect;
+  if (!intersect(Ray(point, dir), &isect)) {
+    return false;
+  }
+
+  *positionOut = isect.position;
+  *normalOut = isect.normal;
+  return true;
+}
+
+float Geom::pdf(const Vec& point, const Vec& dir) const {
+  BSphere bounds = boundSphere();
+  if (bounds.contains(point)) {
+    return math::uniformSampleSpherePDF();
+  }
+
+  Vec dirToOrigin = bounds.origin - point;
+  float theta = asinf(bounds.radius / dirToOrigin.norm());
+
+  Vec normal = dirToOrigin.normalized();
+  Vec tangent;
+  Vec binormal;
+  math::coordSystem(normal, &tangent, &binormal);
+
+  Vec dirLocal = math::worldToLocal(dir, tangent, binormal, normal);
+  return math::uniformSampleConePDF(theta, dirLocal);
+}
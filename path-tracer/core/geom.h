@@ -62,6 +62,80 @@ public:
    */
   virtual BSphere boundSphere() const;
 
+  /**
+   * The total surface area of the geometry.
+   */
+  virtual float area() const = 0;
+
+  /**
+   * Returns true if the geometry is exactly its bounding sphere with normals
+   * facing outwards, so that it looks like a uniformly-lit disc of the same
+   * angular size from any point outside of it. Returns false by default.
+   */
+  virtual bool isSpherical() const;
+
+  /**
+   * Bounds the directions of the geometry's surface normals with a cone.
+   * If this method is not overriden, then the cone covers all directions.
+   *
+   * @param axisOut     [out] the central axis of the cone
+   * @param cosThetaOut [out] the cosine of the cone's half-angle
+   */
+  virtual void boundNormals(Vec* axisOut, float* cosThetaOut) const;
+
+  /**
+   * Samples a point uniformly by area on the surface of the geometry, so the
+   * probability of the point with respect to area is 1 / Geom::area().
+   *
+   * @param rng               the per-thread RNG in use
+   * @param positionOut [out] the sampled point on the surface
+   * @param normalOut   [out] the surface normal at the sampled point
+   */
+  virtual void samplePosition(
+    Randomness& rng,
+    Vec* positionOut,
+    Vec* normalOut
+  ) const = 0;
+
+  /**
+   * Samples a point on the surface of the geometry that is visible (ignoring
+   * occlusion by other geometry) from a reference point. The sampling is done
+   * with respect to solid angle as seen from the reference point.
+   *
+   * If this method is not overriden, then directions are sampled uniformly in
+   * the cone subtended by the bounding sphere and intersected with the
+   * geometry, so the sample might miss. If you override this method, you must
+   * also override Geom::pdf.
+   *
+   * @param rng               the per-thread RNG in use
+   * @param point             the reference point from which the geometry is
+   *                          seen
+   * @param positionOut [out] the sampled point on the surface
+   * @param normalOut   [out] the surface normal at the sampled point
+   * @param pdfOut      [out] the probability of sampling the direction from
+   *                          the reference point towards the sampled point,
+   *                          with respect to solid angle
+   * @returns                 true if a point was sampled, false otherwise
+   */
+  virtual bool sampleSurface(
+    Randomness& rng,
+    const Vec& point,
+    Vec* positionOut,
+    Vec* normalOut,
+    float* pdfOut
+  ) const;
+
+  /**
+   * Returns the probability, with respect to solid angle, that
+   * Geom::sampleSurface would sample the given direction from the given
+   * reference point.
+   *
+   * @param point the reference point from which the geometry is seen
+   * @param dir   the (normalized) direction from the reference point
+   * @returns     the probability of sampling the direction
+   */
+  virtual float pdf(const Vec& point, const Vec& dir) const;
+
   /**
    * Refines a composite object into its constituent parts until the
    * parts can be intersected.
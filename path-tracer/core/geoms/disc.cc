@@ -10,7 +10,10 @@ geoms::Disc::Disc(
 ) : Geom(m, l),
     radiusOuterSquared(rOuter * rOuter), radiusInnerSquared(rInner * rInner),
     radiusOuter(rOuter), radiusInner(rInner),
-    origin(o), normal(n.normalized()) {}
+    origin(o), normal(n.normalized())
+{
+  init();
+}
 
 geoms::Disc::Disc(const geoms::Disc& other)
   : Geom(other.mat, other.light),
@@ -18,13 +21,27 @@ geoms::Disc::Disc(const geoms::Disc& other)
     radiusInnerSquared(other.radiusInnerSquared),
     radiusOuter(other.radiusOuter),
     radiusInner(other.radiusInner),
-    origin(other.origin), normal(other.normal) {}
+    origin(other.origin), normal(other.normal)
+{
+  init();
+}
 
 geoms::Disc::Disc(const Node& n)
   : Disc(n.getVec("origin"), n.getVec("normal"),
          n.getFloat("radiusOuter"), n.getFloat("radiusInner"),
          n.getMaterial("mat"), n.getLight("light")) {}
 
+void geoms::Disc::init() {
+  math::coordSystem(normal, &tangent, &binormal);
+
+  Vec tr = tangent * radiusOuter;
+  Vec br = binormal * radiusOuter;
+
+  bounds = BBox(origin + tr + br, origin - tr - br);
+  bounds.expand(origin + tr - br);
+  bounds.expand(origin - tr + br);
+}
+
 bool geoms::Disc::intersect(const Ray& r, Intersection* isectOut) const {
   // See Wikipedia:
   // <http://en.wikipedia.org/wiki/Line%E2%80%93disc_intersection>
@@ -76,20 +93,80 @@ bool geoms::Disc::intersectShadow(const Ray& r, float maxDist) const {
 }
 
 BBox geoms::Disc::boundBox() const {
-  Vec tangent;
-  Vec binormal;
-  math::coordSystem(normal, &tangent, &binormal);
+  return bounds;
+}
 
-  Vec tr = tangent * radiusOuter;
-  Vec br = binormal * radiusOuter;
+BSphere geoms::Disc::boundSphere() const {
+  return BSphere(origin, radiusOuter);
+}
 
-  BBox b(origin + tr + br, origin - tr - br);
-  b.expand(origin + tr - br);
-  b.expand(origin - tr + br);
+float geoms::Disc::area() const {
+  return math::PI * (radiusOuterSquared - radiusInnerSquared);
+}
 
-  return b;
+void geoms::Disc::boundNormals(Vec* axisOut, float* cosThetaOut) const {
+  *axisOut = normal;
+  *cosThetaOut = 1.0f;
 }
 
-BSphere geoms::Disc::boundSphere() const {
-  return BSphere(origin, radiusOuter);
+void geoms::Disc::samplePosition(
+  Randomness& rng,
+  Vec* positionOut,
+  Vec* normalOut
+) const {
+  float r = sqrtf(rng.nextFloat(radiusInnerSquared, radiusOuterSquared));
+  float phi = rng.nextFloat(math::TWO_PI);
+  *positionOut = origin + r * (cosf(phi) * tangent + sinf(phi) * binormal);
+  *normalOut = normal;
+}
+
+bool geoms::Disc::sampleSurface(
+  Randomness& rng,
+  const Vec& point,
+  Vec* positionOut,
+  Vec* normalOut,
+  float* pdfOut
+) const {
+  // Sample uniformly by area over the annulus between the inner and outer
+  // radii, so that the hole is never chosen.
+  float r = sqrtf(rng.nextFloat(radiusInnerSquared, radiusOuterSquared));
+  float phi = rng.nextFloat(math::TWO_PI);
+  Vec pt = origin + r * (cosf(phi) * tangent + sinf(phi) * binormal);
+
+  // Convert the area density to a solid angle density at the point.
+  Vec toPt = pt - point;
+  float dist2 = toPt.squaredNorm();
+  if (dist2 == 0.0f) {
+    return false;
+  }
+
+  float cosTheta = fabsf(normal.dot(toPt)) / sqrtf(dist2);
+  if (cosTheta == 0.0f) {
+    return false;
+  }
+
+  *positionOut = pt;
+  *normalOut = normal;
+  *pdfOut = dist2 / (cosTheta * area());
+  return true;
+}
+
+float geoms::Disc::pdf(const Vec& point, const Vec& dir) const {
+  float denom = dir.dot(normal);
+  if (denom == 0.0f) {
+    return 0.0f;
+  }
+
+  float d = (origin - point).dot(normal) / denom;
+  if (!math::isPositive(d)) {
+    return 0.0f;
+  }
+
+  float isectToOriginDist = (point + dir * d - origin).squaredNorm();
+  if (isectToOriginDist > radiusOuterSquared
+      || isectToOriginDist < radiusInnerSquared) {
+    return 0.0f;
+  }
+
+  return (d * d) / (fabsf(denom) * area());
 }
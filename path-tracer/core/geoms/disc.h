@@ -10,6 +10,12 @@ namespace geoms {
   class Disc : public Geom {
     const float radiusOuterSquared; /** The square of the outer radius. **/
     const float radiusInnerSquared; /** The square of the inner radius. **/
+    Vec tangent; /**< A unit vector in the disc's plane. */
+    Vec binormal; /**< The unit vector perpendicular to normal and tangent. */
+    BBox bounds; /**< The cached bounding box. */
+
+    /** Computes the cached frame and bounds from the disc's parameters. */
+    void init();
 
   public:
     const float radiusOuter; /**< The center-to-outer-edge distance. */
@@ -50,6 +56,21 @@ namespace geoms {
     virtual bool intersectShadow(const Ray& r, float maxDist) const override;
     virtual BBox boundBox() const override;
     virtual BSphere boundSphere() const override;
+    virtual bool sampleSurface(
+      Randomness& rng,
+      const Vec& point,
+      Vec* positionOut,
+      Vec* normalOut,
+      float* pdfOut
+    ) const override;
+    virtual float pdf(const Vec& point, const Vec& dir) const override;
+    virtual float area() const override;
+    virtual void samplePosition(
+      Randomness& rng,
+      Vec* positionOut,
+      Vec* normalOut
+    ) const override;
+    virtual void boundNormals(Vec* axisOut, float* cosThetaOut) const override;
   };
 
 }
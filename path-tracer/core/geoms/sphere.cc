@@ -88,3 +88,96 @@ BBox geoms::Sphere::boundBox() const {
 BSphere geoms::Sphere::boundSphere() const {
   return BSphere(origin, radius);
 }
+
+float geoms::Sphere::area() const {
+  return math::FOUR_PI * radius * radius;
+}
+
+bool geoms::Sphere::isSpherical() const {
+  return !inverted;
+}
+
+void geoms::Sphere::samplePosition(
+  Randomness& rng,
+  Vec* positionOut,
+  Vec* normalOut
+) const {
+  Vec dir = math::uniformSampleSphere(rng);
+  *positionOut = origin + dir * radius;
+  *normalOut = inverted ? -dir : dir;
+}
+
+bool geoms::Sphere::sampleSurface(
+  Randomness& rng,
+  const Vec& point,
+  Vec* positionOut,
+  Vec* normalOut,
+  float* pdfOut
+) const {
+  Vec toOrigin = origin - point;
+  float dc2 = toOrigin.squaredNorm();
+  float r2 = radius * radius;
+
+  Vec pt;
+  if (dc2 <= r2) {
+    // Inside the sphere, every direction hits the surface exactly once, so
+    // sample directions uniformly and find the hit point analytically.
+    Vec dir = math::uniformSampleSphere(rng);
+    float b = dir.dot(-toOrigin);
+    float t = -b + sqrtf(max(0.0f, b * b - (dc2 - r2)));
+    pt = point + dir * t;
+    *pdfOut = math::uniformSampleSpherePDF();
+  } else {
+    // Outside the sphere, sample the cone of directions that the sphere
+    // subtends, and then find the point on the sphere in that direction.
+    // See Pharr & Humphreys (3rd ed.) section 14.2.2.
+    float dc = sqrtf(dc2);
+    Vec wc = toOrigin / dc;
+    Vec wcX;
+    Vec wcY;
+    math::coordSystem(wc, &wcX, &wcY);
+
+    float sinThetaMax2 = r2 / dc2;
+    float cosThetaMax = sqrtf(max(0.0f, 1.0f - sinThetaMax2));
+    float cosTheta = rng.nextFloat(cosThetaMax, 1.0f);
+    float sinTheta2 = max(0.0f, 1.0f - cosTheta * cosTheta);
+    float phi = rng.nextFloat(math::TWO_PI);
+
+    // Distance from the reference point to the nearer hit along the sampled
+    // direction, and the angle from the sphere's center to the hit point.
+    float ds = dc * cosTheta - sqrtf(max(0.0f, r2 - dc2 * sinTheta2));
+    float cosAlpha = (dc2 + r2 - ds * ds) / (2.0f * dc * radius);
+    float sinAlpha = sqrtf(max(0.0f, 1.0f - cosAlpha * cosAlpha));
+
+    Vec n = math::localToWorld(
+      Vec(sinAlpha * cosf(phi), sinAlpha * sinf(phi), cosAlpha),
+      -wcX,
+      -wcY,
+      -wc
+    );
+    pt = origin + n * radius;
+    *pdfOut = 1.0f / (math::TWO_PI * (1.0f - cosThetaMax));
+  }
+
+  *positionOut = pt;
+  *normalOut = (inverted ? origin - pt : pt - origin).normalized();
+  return true;
+}
+
+float geoms::Sphere::pdf(const Vec& point, const Vec& dir) const {
+  Vec toOrigin = origin - point;
+  float dc2 = toOrigin.squaredNorm();
+  float r2 = radius * radius;
+
+  if (dc2 <= r2) {
+    return math::uniformSampleSpherePDF();
+  }
+
+  float cosThetaMax = sqrtf(max(0.0f, 1.0f - r2 / dc2));
+  if (dir.dot(toOrigin) <= cosThetaMax * sqrtf(dc2)) {
+    // Outside the cone subtended by the sphere.
+    return 0.0f;
+  }
+
+  return 1.0f / (math::TWO_PI * (1.0f - cosThetaMax));
+}
@@ -43,6 +43,21 @@ namespace geoms {
     virtual bool intersectShadow(const Ray& r, float maxDist) const override;
     virtual BBox boundBox() const override;
     virtual BSphere boundSphere() const override;
+    virtual bool sampleSurface(
+      Randomness& rng,
+      const Vec& point,
+      Vec* positionOut,
+      Vec* normalOut,
+      float* pdfOut
+    ) const override;
+    virtual float pdf(const Vec& point, const Vec& dir) const override;
+    virtual float area() const override;
+    virtual void samplePosition(
+      Randomness& rng,
+      Vec* positionOut,
+      Vec* normalOut
+    ) const override;
+    virtual bool isSpherical() const override;
   };
 
 }
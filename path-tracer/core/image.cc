@@ -1,17 +1,44 @@
 #include "image.h"
+#include <limits>
+#include <boost/format.hpp>
+#include "render_pool.h"
+
+using boost::format;
 
 Image::Image(long ww, long hh, long spp, float fw)
   : currentIteration(boost::extents[hh][ww][spp]),
     rawData(boost::extents[hh][ww]),
+    currentSplats(size_t(ww * hh * 3)),
+    splatData(boost::extents[hh][ww]),
+    featureData(boost::extents[hh][ww]),
+    objectIdDistances(boost::extents[hh][ww]),
+    sampleCounts(boost::extents[hh][ww]),
+    denoiser(ww, hh),
+    denoisedData(boost::extents[hh][ww]),
+    hasDenoised(false),
     lock(), counter(0),
     w(ww), h(hh), samplesPerPixel(spp), filterWidth(fw)
 {
-  // Clear the data array.
+  clear();
+}
+
+void Image::clear() {
+  lock.lock();
+
   for (long y = 0; y < h; ++y) {
     for (long x = 0; x < w; ++x) {
       rawData[y][x] = Vec4(0, 0, 0, 0);
+      splatData[y][x] = Vec(0, 0, 0);
+      featureData[y][x] = Features();
+      denoisedData[y][x] = Vec(0, 0, 0);
+      objectIdDistances[y][x] = std::numeric_limits<float>::max();
+      sampleCounts[y][x] = 0;
     }
   }
+  hasDenoised = false;
+  counter = 0;
+
+  lock.unlock();
 }
 
 uint32_t Image::MakeRgbaColor(float r, float g, float b) {
@@ -27,11 +54,26 @@ void Image::setSample(
   float ptX,
   float ptY,
   long idx,
-  const Vec& color
+  const Vec& color,
+  const Features& features
 ) {
   Sample& s = currentIteration[y][x][idx];
   s.position = Vec2(ptX, ptY);
   s.color = color;
+  s.features = features;
+}
+
+void Image::addSplat(float ptX, float ptY, const Vec& color) {
+  long x = long(floorf(ptX + 0.5f));
+  long y = long(floorf(ptY + 0.5f));
+  if (x < 0 || x >= w || y < 0 || y >= h) {
+    return;
+  }
+
+  size_t idx = size_t((y * w + x) * 3);
+  currentSplats[idx].add(color[0]);
+  currentSplats[idx + 1].add(color[1]);
+  currentSplats[idx + 2].add(color[2]);
 }
 
 void Image::commitSamples() {
@@ -68,29 +110,198 @@ void Image::commitSamples() {
     }
   }
 
-  lock.unlock();
+  for (long y = 0; y < h; ++y) {
+    for (long x = 0; x < w; ++x) {
+      size_t idx = size_t((y * w + x) * 3);
+      for (size_t c = 0; c < 3; ++c) {
+        splatData[y][x][long(c)] += currentSplats[idx + c].load();
+        currentSplats[idx + c] = AtomicFloat(0.0f);
+      }
 
+      // Features are only box-filtered, since the denoiser works per pixel.
+      // Object IDs can't be averaged, so keep the one nearest the center.
+      Features& f = featureData[y][x];
+      for (long i = 0; i < samplesPerPixel; ++i) {
+        const Sample& s = currentIteration[y][x][i];
+        f.albedo += s.features.albedo;
+        f.normal += s.features.normal;
+        f.depth += s.features.depth;
+
+        float distance = (s.position - Vec2(float(x), float(y))).norm();
+        if (distance < objectIdDistances[y][x]) {
+          f.objectId = s.features.objectId;
+          objectIdDistances[y][x] = distance;
+        }
+      }
+      sampleCounts[y][x] += samplesPerPixel;
+    }
+  }
+
+  // Count the iteration while still locked, so that the splats are always
+  // scaled by the number of iterations they were gathered over.
   counter++;
+
+  lock.unlock();
+}
+
+Vec Image::pixelColor(long x, long y, float splatScale) const {
+  const Vec4& px = rawData[y][x];
+  return px.head<3>() / px.w() + splatData[y][x] * splatScale;
+}
+
+float Image::splatScaleFor(int iterations) const {
+  return iterations > 0
+    ? 1.0f / float(long(iterations) * samplesPerPixel)
+    : 0.0f;
+}
+
+void Image::denoise(RenderPool* pool) {
+  lock.lock();
+
+  int iterations = counter.load();
+  if (iterations == 0) {
+    lock.unlock();
+    return;
+  }
+
+  float splatScale = splatScaleFor(iterations);
+  for (long y = 0; y < h; ++y) {
+    for (long x = 0; x < w; ++x) {
+      const Features& f = featureData[y][x];
+      float featureScale = 1.0f / float(sampleCounts[y][x]);
+      denoiser.setPixel(
+        x,
+        y,
+        pixelColor(x, y, splatScale),
+        f.albedo * featureScale,
+        f.normal * featureScale,
+        f.depth * featureScale
+      );
+    }
+  }
+
+  lock.unlock();
+
+  denoiser.denoise(pool);
+
+  lock.lock();
+
+  for (long y = 0; y < h; ++y) {
+    for (long x = 0; x < w; ++x) {
+      denoisedData[y][x] = denoiser.result(x, y);
+    }
+  }
+  hasDenoised = true;
+
+  lock.unlock();
 }
 
-void Image::writeToNaClImage(pp::ImageData* buffer, int* counterOut) {
+Vec Image::pixelEstimate(long x, long y) const {
+  if (rawData[y][x].w() <= 0.0f) {
+    return Vec(0, 0, 0);
+  }
+
+  return pixelColor(x, y, splatScaleFor(counter.load()));
+}
+
+Image::Output Image::outputFromName(const std::string& name) {
+  if (name == "beauty") {
+    return Output::BEAUTY;
+  } else if (name == "denoised") {
+    return Output::DENOISED;
+  } else if (name == "albedo") {
+    return Output::ALBEDO;
+  } else if (name == "normal") {
+    return Output::NORMAL;
+  } else if (name == "depth") {
+    return Output::DEPTH;
+  } else if (name == "objectId") {
+    return Output::OBJECT_ID;
+  } else if (name == "sampleCount") {
+    return Output::SAMPLE_COUNT;
+  }
+
+  throw std::runtime_error(
+    str(format("%1% is not a recognized output") % name)
+  );
+}
+
+Vec Image::outputColor(
+  long x,
+  long y,
+  Output output,
+  float splatScale,
+  float maxValue
+) const {
+  const Features& f = featureData[y][x];
+  long count = sampleCounts[y][x];
+  float featureScale = count > 0 ? 1.0f / float(count) : 0.0f;
+
+  switch (output) {
+    case Output::BEAUTY:
+      return pixelColor(x, y, splatScale);
+    case Output::DENOISED:
+      // The denoised image is refreshed every few iterations, in between
+      // which it lags behind a little.
+      return hasDenoised ? denoisedData[y][x] : pixelColor(x, y, splatScale);
+    case Output::ALBEDO:
+      return f.albedo * featureScale;
+    case Output::NORMAL:
+      return (f.normal * featureScale + Vec(1, 1, 1)) * 0.5f;
+    case Output::DEPTH:
+      return Vec(1, 1, 1) * (f.depth * featureScale / maxValue);
+    case Output::OBJECT_ID: {
+      // Scramble the ID so that neighboring objects look different.
+      uint32_t hash = uint32_t(f.objectId) * 2654435761u;
+      if (f.objectId == 0) {
+        return Vec(0, 0, 0);
+      }
+      return Vec(
+        float(hash & 0xFF),
+        float((hash >> 8) & 0xFF),
+        float((hash >> 16) & 0xFF)
+      ) / 255.0f;
+    }
+    case Output::SAMPLE_COUNT:
+      return Vec(1, 1, 1) * (float(count) / maxValue);
+  }
+
+  return Vec(0, 0, 0);
+}
+
+void Image::writeToNaClImage(
+  pp::ImageData* buffer,
+  int* counterOut,
+  Output output
+) {
   lock.lock();
 
   int dstWidth = buffer->size().width();
   int dstHeight = buffer->size().height();
 
+  float splatScale = splatScaleFor(counter.load());
+
+  // Depths and sample counts are unbounded, so scale them by the largest.
+  float maxValue = std::numeric_limits<float>::min();
+  for (long y = 0; y < h; ++y) {
+    for (long x = 0; x < w; ++x) {
+      long count = sampleCounts[y][x];
+      if (output == Output::DEPTH && count > 0) {
+        maxValue = std::max(maxValue, featureData[y][x].depth / float(count));
+      } else if (output == Output::SAMPLE_COUNT) {
+        maxValue = std::max(maxValue, float(count));
+      }
+    }
+  }
+
   for (int y = 0; y < dstHeight; ++y) {
     for (int x = 0; x != dstWidth; ++x) {
       uint32_t* pxAddr = buffer->GetAddr32(pp::Point(x, y));
       if (x >= w || y >= h) {
         *pxAddr = 0xFF000000;
       } else {
-        Vec4& px = rawData[y][x];
-        *pxAddr = MakeRgbaColor(
-          px.x() / px.w(),
-          px.y() / px.w(),
-          px.z() / px.w()
-        );
+        Vec c = outputColor(x, y, output, splatScale, maxValue);
+        *pxAddr = MakeRgbaColor(c.x(), c.y(), c.z());
       }
     }
   }
@@ -2,20 +2,57 @@
 #include <boost/multi_array.hpp>
 #include <mutex>
 #include <atomic>
+#include <string>
+#include <vector>
 #include "ppapi/cpp/image_data.h"
+#include "atomic_float.h"
+#include "denoiser.h"
 #include "math.h"
 
 class Image {
+public:
+  /**
+   * The properties of the first diffuse surface that a sample's path reached,
+   * which guide the denoiser and are output alongside the image.
+   */
+  struct Features {
+    Vec albedo; /**< The color of the surface. */
+    Vec normal; /**< The normal of the surface. */
+    float depth; /**< The length of the path up to the surface. */
+    int objectId; /**< The ID of the surface's object, or 0 if none. */
+
+    Features() : albedo(0, 0, 0), normal(0, 0, 0), depth(0.0f), objectId(0) {}
+  };
+
+  /** The buffers that the image can output. */
+  enum class Output {
+    BEAUTY, /**< The rendered image, as sampled so far. */
+    /**
+     * The most recent denoised image, or the rendered image until the first
+     * denoise.
+     */
+    DENOISED,
+    ALBEDO, /**< The average albedo of the first diffuse surfaces. */
+    NORMAL, /**< The average normal, mapped from [-1, 1] to [0, 1]. */
+    DEPTH, /**< The average depth, relative to the deepest pixel. */
+    OBJECT_ID, /**< The object nearest the pixel center, as a random color. */
+    SAMPLE_COUNT /**< The samples taken, relative to the most in any pixel. */
+  };
 
+private:
   struct Sample {
     Vec2 position;
     Vec color;
+    Features features;
 
-    Sample() : position(0, 0), color(0, 0, 0) {}
+    Sample() : position(0, 0), color(0, 0, 0), features() {}
   };
 
   typedef boost::multi_array<Sample, 3> SampleArray;
   typedef boost::multi_array<Vec4, 2> PixelArray;
+  typedef boost::multi_array<Vec, 2> SplatArray;
+  typedef boost::multi_array<Features, 2> FeatureArray;
+  typedef boost::multi_array<long, 2> CountArray;
 
   /** The samples from the current iteration. */
   SampleArray currentIteration;
@@ -23,6 +60,34 @@ class Image {
   /** The raw sampled colors and weights. */
   PixelArray rawData;
 
+  /** The splatted colors from the current iteration, three per pixel. */
+  std::vector<AtomicFloat> currentSplats;
+
+  /** The sum of the splatted colors from all iterations. */
+  SplatArray splatData;
+
+  /**
+   * The sum of the features of all samples taken in each pixel, except for
+   * the object ID, which is point-sampled from the sample nearest the pixel
+   * center.
+   */
+  FeatureArray featureData;
+
+  /** The distance from each pixel center to its object ID's sample. */
+  boost::multi_array<float, 2> objectIdDistances;
+
+  /** The number of samples taken in each pixel. */
+  CountArray sampleCounts;
+
+  /** Filters the image using the features. */
+  Denoiser denoiser;
+
+  /** The most recent denoised image. */
+  SplatArray denoisedData;
+
+  /** Whether the image has been denoised, so denoisedData is valid. */
+  bool hasDenoised;
+
   /** Lock on the data in rawData. */
   std::mutex lock;
 
@@ -31,6 +96,30 @@ class Image {
 
   static uint32_t MakeRgbaColor(float r, float g, float b);
 
+  /**
+   * Returns the color of the given pixel, including the splats scaled by the
+   * given factor. The lock must be held.
+   */
+  Vec pixelColor(long x, long y, float splatScale) const;
+
+  /**
+   * Returns the factor that splats are scaled by, given the number of
+   * iterations.
+   */
+  float splatScaleFor(int iterations) const;
+
+  /**
+   * Returns the given pixel of the given output, with depth and sample counts
+   * divided by the given maximum. The lock must be held.
+   */
+  Vec outputColor(
+    long x,
+    long y,
+    Output output,
+    float splatScale,
+    float maxValue
+  ) const;
+
 public:
   /**
    * Default width (radius) of the filter kernel.
@@ -68,12 +157,14 @@ public:
    * This is thread-safe if no two threads call this function with the same
    * arguments (x, y, idx) at the same time. Otherwise, it is NOT thread-safe.
    *
-   * @param x     the x-coordinate of the pixel for which the sample was taken
-   * @param y     the y-coordinate of the pixel for which the sample was taken
-   * @param ptX   the actual x-position of the sample, if jittered
-   * @param ptY   the actual y-position of the sample, if jittered
-   * @param idx   the index of the sample, 0 <= idx < samplesPerPixel
-   * @param color the color of the sample
+   * @param x        the x-coordinate of the pixel the sample was taken for
+   * @param y        the y-coordinate of the pixel the sample was taken for
+   * @param ptX      the actual x-position of the sample, if jittered
+   * @param ptY      the actual y-position of the sample, if jittered
+   * @param idx      the index of the sample, 0 <= idx < samplesPerPixel
+   * @param color    the color of the sample
+   * @param features the features of the first diffuse surface that the
+   *                 sample reached
    */
   void setSample(
     long x,
@@ -81,14 +172,66 @@ public:
     float ptX,
     float ptY,
     long idx,
-    const Vec& color
+    const Vec& color,
+    const Features& features = Features()
   );
 
+  /**
+   * Adds a color to the pixel nearest to the given position for the current
+   * iteration, as when tracing light paths to the camera. Splatted colors are
+   * not filtered; they are summed and divided by the total number of samples
+   * per pixel, and then added to the filtered samples. This is thread-safe.
+   *
+   * @param ptX   the x-position of the splat
+   * @param ptY   the y-position of the splat
+   * @param color the color to add
+   */
+  void addSplat(float ptX, float ptY, const Vec& color);
+
   /**
    * Takes the currently-set samples, filters their values, and adds them to
-   * the image.
+   * the image. Also adds the current iteration's splats.
    */
   void commitSamples();
 
-  void writeToNaClImage(pp::ImageData* buffer, int* counterOut);
+  /**
+   * Throws away everything committed so far, so that the image can be
+   * rendered from scratch.
+   */
+  void clear();
+
+  /**
+   * Denoises the image as it stands, guided by the features of the samples,
+   * and keeps the result for Output::DENOISED until the next time this is
+   * called. The filter runs on the given threads, without holding the lock.
+   *
+   * @param pool the threads to filter with
+   */
+  void denoise(RenderPool* pool);
+
+  /**
+   * Returns the color of the given pixel over the iterations committed so
+   * far, or black if there are none. This does not lock, so it must not be
+   * called while samples are being committed.
+   */
+  Vec pixelEstimate(long x, long y) const;
+
+  /**
+   * Returns the output with the given name, which is "beauty", "albedo",
+   * "normal", "depth", "objectId", or "sampleCount".
+   */
+  static Output outputFromName(const std::string& name);
+
+  /**
+   * Writes the given output into the given NaCl image.
+   *
+   * @param buffer             the NaCl image to write into
+   * @param counterOut  [out]  if not null, the number of iterations so far
+   * @param output             the buffer to write
+   */
+  void writeToNaClImage(
+    pp::ImageData* buffer,
+    int* counterOut,
+    Output output = Output::BEAUTY
+  );
 };
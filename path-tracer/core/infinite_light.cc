@@ -0,0 +1,77 @@
+#include "infinite_light.h"
+#include "accelerator.h"
+#include "sd_tree.h"
+
+InfiniteLight::~InfiniteLight() {}
+
+void InfiniteLight::sampleLight(
+  Randomness& rng,
+  const Accelerator* accel,
+  const Vec& point,
+  Vec* dirToLightOut,
+  Vec* colorOut,
+  float* pdfOut
+) const {
+  Vec dirToLight;
+  Vec emittedColor;
+  float pdf;
+  sampleDirection(rng, &dirToLight, &emittedColor, &pdf);
+
+  // Any geometry in the way occludes the light.
+  Ray pointToLight(point + math::VERY_SMALL * dirToLight, dirToLight);
+  if (pdf > 0.0f && accel->intersectShadow(pointToLight, math::VERY_BIG)) {
+    emittedColor = Vec(0, 0, 0);
+  }
+
+  *dirToLightOut = dirToLight;
+  *colorOut = emittedColor;
+  *pdfOut = pdf;
+}
+
+Vec InfiniteLight::directIlluminate(
+  Randomness& rng,
+  const ShadingContext& ctx,
+  const Accelerator* accel,
+  float lightSelectPdf,
+  const DTree* guide,
+  float guideProb
+) const {
+  // Sample random from light PDF.
+  Vec outgoingWorld;
+  Vec lightColor;
+  float lightPdf;
+  sampleLight(
+    rng,
+    accel,
+    ctx.isect.position,
+    &outgoingWorld,
+    &lightColor,
+    &lightPdf
+  );
+
+  if (lightPdf > 0.0f && !math::isVectorExactlyZero(lightColor)) {
+    // The light strategy also includes the choice of this light.
+    lightPdf *= lightSelectPdf;
+
+    // Evaluate material BSDF and PDF as well.
+    Vec bsdf;
+    float bsdfPdf;
+    ctx.mat->evalWorld(ctx, outgoingWorld, &bsdf, &bsdfPdf);
+
+    if (guide) {
+      // The path continues from a mixture of the material and the guide, so
+      // that is the strategy to weight against.
+      bsdfPdf = guideProb * guide->pdf(outgoingWorld)
+        + (1.0f - guideProb) * bsdfPdf;
+    }
+
+    if (!math::isVectorExactlyZero(bsdf)) {
+      float lightWeight = math::powerHeuristic(1, lightPdf, 1, bsdfPdf);
+      return bsdf.cwiseProduct(lightColor)
+        * fabsf(ctx.isect.normal.dot(outgoingWorld))
+        * lightWeight / lightPdf;
+    }
+  }
+
+  return Vec(0, 0, 0);
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "core.h"
+#include "material.h"
+
+class Accelerator;
+class DTree;
+
+/**
+ * The base interface for lights that are infinitely far away, such as an
+ * environment surrounding the whole scene. Rather than being attached to
+ * geometry, they are seen by rays that escape the scene without hitting
+ * anything.
+ */
+class InfiniteLight {
+public:
+  virtual ~InfiniteLight();
+
+  /**
+   * Returns the radiance arriving along a ray that escapes the scene.
+   *
+   * @param dir the (normalized) direction of the escaping ray
+   */
+  virtual Vec emit(const Vec& dir) const = 0;
+
+  /**
+   * Samples a direction towards the light, ignoring occlusion.
+   *
+   * @param rng            the per-thread RNG in use
+   * @param dirOut   [out] the sampled direction towards the light
+   * @param colorOut [out] the radiance arriving from the sampled direction
+   * @param pdfOut   [out] the probability of sampling the direction, with
+   *                       respect to solid angle
+   */
+  virtual void sampleDirection(
+    Randomness& rng,
+    Vec* dirOut,
+    Vec* colorOut,
+    float* pdfOut
+  ) const = 0;
+
+  /**
+   * Returns the probability that InfiniteLight::sampleDirection would sample
+   * the given direction, with respect to solid angle.
+   */
+  virtual float pdf(const Vec& dir) const = 0;
+
+  /**
+   * Estimates the total power (flux) that the light delivers into the scene,
+   * as a luminance. This is comparable to AreaLight::power.
+   *
+   * @param sceneBounds a sphere bounding all of the scene's geometry
+   */
+  virtual float power(const BSphere& sceneBounds) const = 0;
+
+  /**
+   * Samples the light from a given point via a randomly-chosen direction,
+   * taking into account occlusion by the scene geometry.
+   *
+   * @param rng                  the per-thread RNG in use
+   * @param accel                the accelerator containing the scene geometry
+   * @param point                the world-space point being illuminated
+   * @param dirToLightOut  [out] the randomly-sampled direction from the point
+   *                             towards the light
+   * @param colorOut       [out] the radiance arriving at the point
+   * @param pdfOut         [out] the probability of choosing the direction
+   */
+  void sampleLight(
+    Randomness& rng,
+    const Accelerator* accel,
+    const Vec& point,
+    Vec* dirToLightOut,
+    Vec* colorOut,
+    float* pdfOut
+  ) const;
+
+  /**
+   * Computes the direct illumination from the light onto a piece of geometry
+   * at the specified intersection point. As with AreaLight::directIlluminate,
+   * only the light-sampling half of the multiple importance sampling estimate
+   * is computed here.
+   *
+   * @param rng             the per-thread RNG in use
+   * @param ctx             the shading context of the geometry that should be
+   *                        illuminated
+   * @param accel           the accelerator containing the scene geometry
+   * @param lightSelectPdf  the probability with which this light was chosen
+   *                        out of all of the scene's lights
+   * @param guide           the guiding distribution that the path continues
+   *                        from, or null if it only samples the material
+   * @param guideProb       the probability of continuing the path from the
+   *                        guiding distribution rather than the material
+   */
+  Vec directIlluminate(
+    Randomness& rng,
+    const ShadingContext& ctx,
+    const Accelerator* accel,
+    float lightSelectPdf = 1.0f,
+    const DTree* guide = nullptr,
+    float guideProb = 0.0f
+  ) const;
+};
@@ -0,0 +1,5 @@
+#pragma once
+#include "bidirectional.h"
+#include "instant_radiosity.h"
+#include "metropolis.h"
+#include "photon_mapping.h"
@@ -0,0 +1,445 @@
+#include "bidirectional.h"
+#include "../camera.h"
+#include "../light.h"
+#include "../material.h"
+
+integrators::Bidirectional::Bidirectional(Camera& c) : camera(c) {}
+
+Vec integrators::Bidirectional::trace(
+  const LightRay& r,
+  bool onFilm,
+  Randomness& rng
+) {
+  const int maxCameraVertices = MAX_DEPTH + 2;
+  const int maxLightVertices = MAX_DEPTH + 1;
+  PathVertex cameraPath[maxCameraVertices];
+  PathVertex lightPath[maxLightVertices];
+
+  Vec L(0, 0, 0);
+
+  // Light subpaths can only reach the camera through the film, so the other
+  // strategies can't have sampled a path whose ray misses it.
+  Vec forward = camera.camToWorldXform.linear() * Vec(0, 0, -1);
+  cameraPath[0] = PathVertex(
+    PathVertex::Type::CAMERA,
+    Intersection(r.origin, forward, 0.0f),
+    nullptr,
+    Vec(1, 1, 1)
+  );
+  cameraPath[0].offFilm = !onFilm;
+
+  int numCamera = randomWalk(
+    LightRay(r.origin, r.direction, Vec(1, 1, 1)),
+    camera.cameraPdfDir(r.direction),
+    cameraPath,
+    1,
+    maxCameraVertices,
+    rng,
+    &L
+  );
+  int numLight = generateLightSubpath(rng, lightPath, maxLightVertices);
+
+  for (int t = 1; t <= numCamera; ++t) {
+    for (int s = 0; s <= numLight; ++s) {
+      // Emitters seen directly from the camera are already found by s = 0.
+      int depth = s + t - 2;
+      if ((s == 1 && t == 1) || depth < 0 || depth > MAX_DEPTH) {
+        continue;
+      }
+
+      L += connect(lightPath, s, cameraPath, t, rng);
+    }
+  }
+
+  // Light subpaths never start at infinity, so infinite lights are sampled
+  // directly from each camera vertex instead, against the escaped paths.
+  for (int t = 1; t < numCamera && t <= MAX_DEPTH; ++t) {
+    const PathVertex& v = cameraPath[t];
+    if (v.delta || !v.geom->mat) {
+      continue;
+    }
+
+    ShadingContext ctx(v.isect, v.wo, v.geom->mat);
+    for (const InfiniteLight* light : camera.infiniteLights) {
+      L += v.beta.cwiseProduct(
+        light->directIlluminate(rng, ctx, &camera.accel)
+      );
+    }
+  }
+
+  if (camera.clampRadiance) {
+    L[0] = math::clamp(L[0], 0.0f, Camera::BIASED_RADIANCE_CLAMPING);
+    L[1] = math::clamp(L[1], 0.0f, Camera::BIASED_RADIANCE_CLAMPING);
+    L[2] = math::clamp(L[2], 0.0f, Camera::BIASED_RADIANCE_CLAMPING);
+  }
+
+  return L;
+}
+
+int integrators::Bidirectional::randomWalk(
+  LightRay r,
+  float pdfDir,
+  PathVertex* path,
+  int count,
+  int maxVertices,
+  Randomness& rng,
+  Vec* escapedOut
+) const {
+  while (count < maxVertices) {
+    PathVertex& prev = path[count - 1];
+
+    Intersection isect;
+    const Geom* g = camera.accel.intersect(r, &isect);
+    if (!g) {
+      if (escapedOut) {
+        // Weight against the direct sampling of each infinite light, unless
+        // the previous vertex couldn't have been directly illuminated.
+        bool canSampleLight = prev.type == PathVertex::Type::SURFACE
+          && !prev.delta && prev.geom->mat;
+        for (const InfiniteLight* light : camera.infiniteLights) {
+          float weight = canSampleLight
+            ? math::powerHeuristic(1, pdfDir, 1, light->pdf(r.direction))
+            : 1.0f;
+          *escapedOut +=
+            r.color.cwiseProduct(light->emit(r.direction)) * weight;
+        }
+      }
+      break;
+    }
+
+    PathVertex& v = path[count++];
+    v = PathVertex(PathVertex::Type::SURFACE, isect, g, r.color);
+    v.wo = -r.direction;
+    v.pdfFwd = prev.convertDensity(pdfDir, v);
+
+    if (!g->mat || count >= maxVertices) {
+      break;
+    }
+
+    Vec outgoing;
+    Vec bsdf;
+    float pdf;
+    g->mat->sampleWorld(isect, rng, v.wo, &outgoing, &bsdf, &pdf);
+    if (pdf <= 0.0f || math::isVectorExactlyZero(bsdf)) {
+      break;
+    }
+
+    Vec beta =
+      r.color.cwiseProduct(bsdf) * fabsf(isect.normal.dot(outgoing)) / pdf;
+
+    // Materials that aren't directly illuminated scatter in a single
+    // direction, so they can't be connected to and have no usable PDF.
+    float pdfRev;
+    if (!g->mat->shouldDirectIlluminate()) {
+      v.delta = true;
+      pdf = 0.0f;
+      pdfRev = 0.0f;
+    } else {
+      Vec bsdfRev;
+      g->mat->evalWorld(isect, outgoing, v.wo, &bsdfRev, &pdfRev);
+    }
+    prev.pdfRev = v.convertDensity(pdfRev, prev);
+
+    pdfDir = pdf;
+    r = LightRay(isect.position + outgoing * math::VERY_SMALL, outgoing, beta);
+  }
+
+  return count;
+}
+
+int integrators::Bidirectional::generateLightSubpath(
+  Randomness& rng,
+  PathVertex* path,
+  int maxVertices
+) const {
+  if (camera.emitters.empty() || maxVertices < 1) {
+    return 0;
+  }
+
+  float choosePdf;
+  const Geom* emitter =
+    camera.emitters[camera.emitterDistribution.sample(rng, &choosePdf)];
+
+  Vec position;
+  Vec normal;
+  emitter->samplePosition(rng, &position, &normal);
+
+  path[0] = PathVertex(
+    PathVertex::Type::LIGHT,
+    Intersection(position, normal, 0.0f),
+    emitter,
+    emitter->light->color
+  );
+  path[0].pdfFwd = choosePdf / emitter->area();
+
+  // Leave the emitter with a cosine-weighted distribution, which cancels
+  // against the cosine in the emitted power.
+  Vec tangent;
+  Vec binormal;
+  math::coordSystem(normal, &tangent, &binormal);
+  Vec local = math::cosineSampleHemisphere(rng, false);
+  float pdfDir = math::cosineSampleHemispherePDF(local);
+  if (pdfDir <= 0.0f) {
+    return 1;
+  }
+
+  Vec dir = math::localToWorld(local, tangent, binormal, normal);
+  Vec beta = emitter->light->color * (math::PI / path[0].pdfFwd);
+
+  return randomWalk(
+    LightRay(position + dir * math::VERY_SMALL, dir, beta),
+    pdfDir,
+    path,
+    1,
+    maxVertices,
+    rng,
+    nullptr
+  );
+}
+
+Vec integrators::Bidirectional::connect(
+  PathVertex* lightPath,
+  int s,
+  PathVertex* cameraPath,
+  int t,
+  Randomness& rng
+) {
+  Vec L(0, 0, 0);
+  PathVertex sampled;
+
+  if (s == 0) {
+    // The camera subpath found an emitter on its own.
+    const PathVertex& pt = cameraPath[t - 1];
+    L = pt.beta.cwiseProduct(pt.emitted(cameraPath[t - 2]));
+  } else if (t == 1) {
+    // Connect the light subpath to a new point on the lens, and splat it
+    // wherever it lands on the film.
+    const PathVertex& qs = lightPath[s - 1];
+    if (qs.delta || !qs.geom->mat) {
+      return L;
+    }
+
+    Vec eye(0, 0, 0);
+    math::areaSampleDisk(rng, &eye[0], &eye[1]);
+    Vec lensPoint = camera.camToWorldXform * (eye * camera.lensRadius);
+
+    Vec toLens = lensPoint - qs.position();
+    float dist2 = toLens.squaredNorm();
+    Vec dir = toLens / sqrtf(dist2);
+
+    float posX;
+    float posY;
+    if (!camera.projectToFilm(lensPoint, -dir, &posX, &posY)) {
+      return L;
+    }
+
+    Vec forward = camera.camToWorldXform.linear() * Vec(0, 0, -1);
+    sampled = PathVertex(
+      PathVertex::Type::CAMERA,
+      Intersection(lensPoint, forward, 0.0f),
+      nullptr,
+      Vec(1, 1, 1)
+    );
+
+    // The camera's importance is its PDF over the film, so each pixel
+    // receives its share of the light subpaths.
+    Vec splat = qs.beta.cwiseProduct(qs.f(sampled))
+      * (qs.absCos(dir) * camera.cameraPdfDir(-dir) / dist2);
+    if (math::isVectorExactlyZero(splat)
+        || !camera.unoccluded(qs.position(), lensPoint)) {
+      return L;
+    }
+
+    float weight = misWeight(lightPath, s, cameraPath, t, sampled);
+    camera.img.addSplat(posX, posY, splat * weight);
+    return L;
+  } else if (s == 1) {
+    // Connect the camera subpath to a new point on an emitter.
+    const PathVertex& pt = cameraPath[t - 1];
+    if (pt.delta || !pt.geom->mat) {
+      return L;
+    }
+
+    float choosePdf;
+    const Geom* emitter =
+      camera.emitters[camera.emitterDistribution.sample(rng, &choosePdf)];
+
+    Vec lightPoint;
+    Vec lightNormal;
+    float pdf;
+    if (!emitter->sampleSurface(
+          rng, pt.position(), &lightPoint, &lightNormal, &pdf)
+        || pdf <= 0.0f) {
+      return L;
+    }
+
+    sampled = PathVertex(
+      PathVertex::Type::LIGHT,
+      Intersection(lightPoint, lightNormal, 0.0f),
+      emitter,
+      emitter->light->color
+    );
+    sampled.pdfFwd = lightOriginPdf(sampled);
+
+    Vec dir = (lightPoint - pt.position()).normalized();
+    L = pt.beta.cwiseProduct(pt.f(sampled)).cwiseProduct(sampled.emitted(pt))
+      * (pt.absCos(dir) / (choosePdf * pdf));
+    if (math::isVectorExactlyZero(L)
+        || !camera.unoccluded(pt.position(), lightPoint)) {
+      return Vec(0, 0, 0);
+    }
+  } else {
+    // Connect the two subpaths' end vertices.
+    const PathVertex& qs = lightPath[s - 1];
+    const PathVertex& pt = cameraPath[t - 1];
+    if (qs.delta || pt.delta || !qs.geom->mat || !pt.geom->mat) {
+      return L;
+    }
+
+    Vec toPt = pt.position() - qs.position();
+    float dist2 = toPt.squaredNorm();
+    if (dist2 == 0.0f) {
+      return L;
+    }
+    Vec dir = toPt / sqrtf(dist2);
+
+    float g = qs.absCos(dir) * pt.absCos(dir) / dist2;
+    L = qs.beta.cwiseProduct(qs.f(pt)).cwiseProduct(pt.f(qs))
+      .cwiseProduct(pt.beta) * g;
+    if (math::isVectorExactlyZero(L)
+        || !camera.unoccluded(qs.position(), pt.position())) {
+      return Vec(0, 0, 0);
+    }
+  }
+
+  if (math::isVectorExactlyZero(L)) {
+    return L;
+  }
+
+  return L * misWeight(lightPath, s, cameraPath, t, sampled);
+}
+
+float integrators::Bidirectional::misWeight(
+  PathVertex* lightPath,
+  int s,
+  PathVertex* cameraPath,
+  int t,
+  const PathVertex& sampled
+) const {
+  if (s + t == 2) {
+    return 1.0f;
+  }
+
+  // Swap in the vertex that was sampled anew, if any.
+  PathVertex* replaced = nullptr;
+  if (s == 1) {
+    replaced = &lightPath[0];
+  } else if (t == 1) {
+    replaced = &cameraPath[0];
+  }
+
+  PathVertex savedReplaced;
+  if (replaced) {
+    savedReplaced = *replaced;
+    *replaced = sampled;
+  }
+
+  PathVertex* qs = s > 0 ? &lightPath[s - 1] : nullptr;
+  PathVertex* pt = &cameraPath[t - 1];
+  PathVertex* qsMinus = s > 1 ? &lightPath[s - 2] : nullptr;
+  PathVertex* ptMinus = t > 1 ? &cameraPath[t - 2] : nullptr;
+
+  // Save the values that change when the subpaths are joined.
+  float savedPtRev = pt->pdfRev;
+  bool savedPtDelta = pt->delta;
+  float savedPtMinusRev = ptMinus ? ptMinus->pdfRev : 0.0f;
+  float savedQsRev = qs ? qs->pdfRev : 0.0f;
+  bool savedQsDelta = qs ? qs->delta : false;
+  float savedQsMinusRev = qsMinus ? qsMinus->pdfRev : 0.0f;
+
+  // The connected vertices' reverse probabilities are now known.
+  pt->delta = false;
+  pt->pdfRev = s > 0 ? vertexPdf(*qs, qsMinus, *pt) : lightOriginPdf(*pt);
+  if (ptMinus) {
+    ptMinus->pdfRev =
+      s > 0 ? vertexPdf(*pt, qs, *ptMinus) : pt->pdfLight(*ptMinus);
+  }
+  if (qs) {
+    qs->delta = false;
+    qs->pdfRev = vertexPdf(*pt, ptMinus, *qs);
+  }
+  if (qsMinus) {
+    qsMinus->pdfRev = vertexPdf(*qs, pt, *qsMinus);
+  }
+
+  // Sum the ratios of the probabilities of the other strategies to this one
+  // (the balance heuristic). Delta distributions are skipped over, since
+  // they can't be connected to, and so is connecting to the lens when the
+  // camera ray misses the film.
+  auto remap0 = [](float f) { return f != 0.0f ? f : 1.0f; };
+  float sumRatios = 0.0f;
+
+  float ratio = 1.0f;
+  for (int i = t - 1; i > 0; --i) {
+    ratio *= remap0(cameraPath[i].pdfRev) / remap0(cameraPath[i].pdfFwd);
+    if (!cameraPath[i].delta && !cameraPath[i - 1].delta
+        && !cameraPath[i - 1].offFilm) {
+      sumRatios += ratio;
+    }
+  }
+
+  ratio = 1.0f;
+  for (int i = s - 1; i >= 0; --i) {
+    ratio *= remap0(lightPath[i].pdfRev) / remap0(lightPath[i].pdfFwd);
+    bool deltaBefore = i > 0 ? lightPath[i - 1].delta : false;
+    if (!lightPath[i].delta && !deltaBefore) {
+      sumRatios += ratio;
+    }
+  }
+
+  // Restore the subpaths.
+  pt->pdfRev = savedPtRev;
+  pt->delta = savedPtDelta;
+  if (ptMinus) {
+    ptMinus->pdfRev = savedPtMinusRev;
+  }
+  if (qs) {
+    qs->pdfRev = savedQsRev;
+    qs->delta = savedQsDelta;
+  }
+  if (qsMinus) {
+    qsMinus->pdfRev = savedQsMinusRev;
+  }
+  if (replaced) {
+    *replaced = savedReplaced;
+  }
+
+  return 1.0f / (1.0f + sumRatios);
+}
+
+float integrators::Bidirectional::vertexPdf(
+  const PathVertex& v,
+  const PathVertex* prev,
+  const PathVertex& next
+) const {
+  switch (v.type) {
+    case PathVertex::Type::CAMERA:
+      return v.convertDensity(
+        camera.cameraPdfDir(next.position() - v.position()),
+        next
+      );
+    case PathVertex::Type::LIGHT:
+      return v.pdfLight(next);
+    default:
+      return v.pdfSurface(prev, next);
+  }
+}
+
+float integrators::Bidirectional::lightOriginPdf(const PathVertex& v) const {
+  auto it = camera.emitterIndices.find(v.geom);
+  if (it == camera.emitterIndices.end()) {
+    return 0.0f;
+  }
+
+  return camera.emitterDistribution.pdf(it->second) / v.geom->area();
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include "../core.h"
+#include "../path_vertex.h"
+#include "../randomness.h"
+
+class Camera;
+
+namespace integrators {
+
+  /**
+   * Bidirectional path tracing, which renders the image for a camera using
+   * its scene, its film and its lights.
+   */
+  class Bidirectional {
+    /** The maximum number of bounces on a path. */
+    static constexpr int MAX_DEPTH = 16;
+
+    Camera& camera; /**< The camera that the paths are traced for. */
+
+    /**
+     * Extends a subpath by repeatedly sampling materials, adding a vertex each
+     * time geometry is hit.
+     *
+     * @param r           the ray leaving the last vertex on the subpath; its
+     *                    color is the subpath's throughput
+     * @param pdfDir      the probability of the ray's direction, with respect
+     *                    to solid angle
+     * @param path        the subpath, with at least one vertex
+     * @param count       the number of vertices already on the subpath
+     * @param maxVertices the maximum number of vertices on the subpath
+     * @param rng         the per-thread RNG in use
+     * @param escapedOut  [out] if not null, the radiance from infinite lights
+     *                    that the subpath sees when it escapes the scene is
+     *                    added here
+     * @returns           the number of vertices on the extended subpath
+     */
+    int randomWalk(
+      LightRay r,
+      float pdfDir,
+      PathVertex* path,
+      int count,
+      int maxVertices,
+      Randomness& rng,
+      Vec* escapedOut
+    ) const;
+
+    /**
+     * Samples a light subpath, starting on an emitter chosen in proportion to
+     * its power.
+     *
+     * @param rng         the per-thread RNG in use
+     * @param path        [out] the vertices of the subpath
+     * @param maxVertices the maximum number of vertices on the subpath
+     * @returns           the number of vertices on the subpath
+     */
+    int generateLightSubpath(
+      Randomness& rng,
+      PathVertex* path,
+      int maxVertices
+    ) const;
+
+    /**
+     * Connects the first s vertices of a light subpath to the first t
+     * vertices of a camera subpath, and returns the resulting radiance
+     * weighted for multiple importance sampling. When t = 1, the light
+     * subpath is connected to a new point on the lens and splatted onto the
+     * image instead, and zero is returned. When s = 1, a new point is sampled
+     * on an emitter instead of using the light subpath's first vertex.
+     */
+    Vec connect(
+      PathVertex* lightPath,
+      int s,
+      PathVertex* cameraPath,
+      int t,
+      Randomness& rng
+    );
+
+    /**
+     * Returns the multiple importance sampling weight of the path made by
+     * connecting the first s vertices of a light subpath to the first t
+     * vertices of a camera subpath, using the balance heuristic. The subpaths
+     * are modified while computing the weight, but restored afterwards.
+     *
+     * @param lightPath  the light subpath
+     * @param s          the number of light subpath vertices used
+     * @param cameraPath the camera subpath
+     * @param t          the number of camera subpath vertices used
+     * @param sampled    the vertex that was sampled anew, if s = 1 or t = 1
+     */
+    float misWeight(
+      PathVertex* lightPath,
+      int s,
+      PathVertex* cameraPath,
+      int t,
+      const PathVertex& sampled
+    ) const;
+
+    /**
+     * Returns the probability, with respect to area at the next vertex, that
+     * the subpath through the given vertex would continue to the next vertex.
+     *
+     * @param v    the vertex
+     * @param prev the vertex before v, or null to use the direction stored in
+     *             v
+     * @param next the vertex after v
+     */
+    float vertexPdf(
+      const PathVertex& v,
+      const PathVertex* prev,
+      const PathVertex& next
+    ) const;
+
+    /**
+     * Returns the probability, with respect to area, that a light subpath
+     * would start at the given vertex on an emitter.
+     */
+    float lightOriginPdf(const PathVertex& v) const;
+
+  public:
+    /**
+     * Constructs the integrator for the given camera, which must outlive it.
+     */
+    explicit Bidirectional(Camera& c);
+
+    /**
+     * Traces a camera subpath starting with the given ray and a light subpath
+     * starting on a random emitter, and connects every prefix of one to every
+     * prefix of the other, weighting each connection with multiple importance
+     * sampling. Connections that reach the camera directly from the light
+     * subpath are splatted onto the image, and the rest of the sampled
+     * radiance is returned.
+     *
+     * @param r      the ray that starts the camera subpath
+     * @param onFilm whether the ray passes through the film, so that light
+     *               subpaths could also have reached it
+     * @param rng    the per-thread RNG in use
+     * @returns      the sampled radiance of the camera subpath's connections
+     */
+    Vec trace(const LightRay& r, bool onFilm, Randomness& rng);
+  };
+
+}
@@ -0,0 +1,75 @@
+#include "instant_radiosity.h"
+#include "../camera.h"
+
+using std::max;
+
+integrators::InstantRadiosity::InstantRadiosity(Camera& c)
+  : camera(c), virtualLights(), distribution() {}
+
+void integrators::InstantRadiosity::traceVirtualLights() {
+  // So few paths are traced that the master RNG traces them all at once.
+  // Unlike photons, virtual lights are also left where light first lands,
+  // since they light other surfaces rather than their own.
+  virtualLights.clear();
+  std::vector<float> powers;
+  for (int i = 0; i < PATHS; ++i) {
+    camera.traceLightPath(camera.masterRng, [&](
+      const LightRay& r,
+      const Intersection& isect,
+      const Material* mat,
+      int
+    ) {
+      Vec power = r.color / float(PATHS);
+      virtualLights.push_back(
+        VirtualLight{isect, mat, -r.direction, power}
+      );
+      powers.push_back(math::luminance(power));
+    });
+  }
+  distribution = AliasTable(powers);
+}
+
+Vec integrators::InstantRadiosity::gather(
+  const ShadingContext& ctx,
+  Randomness& rng
+) const {
+  if (distribution.empty()) {
+    return Vec(0, 0, 0);
+  }
+
+  float minDist = MIN_DISTANCE * camera.focalLength;
+  Vec sum(0, 0, 0);
+  for (int i = 0; i < SAMPLES; ++i) {
+    float choosePdf;
+    const VirtualLight& light =
+      virtualLights[distribution.sample(rng, &choosePdf)];
+
+    Vec toLight = light.isect.position - ctx.isect.position;
+    float dist2 = toLight.squaredNorm();
+    if (dist2 <= 0.0f) {
+      continue;
+    }
+    Vec dir = toLight / sqrtf(dist2);
+
+    // The light leaves the virtual light as if scattered towards the surface.
+    Vec bsdf;
+    Vec lightBsdf;
+    float pdf;
+    ctx.mat->evalWorld(ctx, dir, &bsdf, &pdf);
+    light.mat->evalWorld(light.isect, -dir, light.direction, &lightBsdf, &pdf);
+
+    float geometry = fabsf(dir.dot(ctx.isect.normal))
+      * fabsf(dir.dot(light.isect.normal))
+      / max(dist2, minDist * minDist);
+    Vec contribution = bsdf.cwiseProduct(lightBsdf).cwiseProduct(light.power)
+      * (geometry / choosePdf);
+    if (contribution.isZero()
+        || !camera.unoccluded(ctx.isect.position, light.isect.position)) {
+      continue;
+    }
+
+    sum += contribution;
+  }
+
+  return sum / float(SAMPLES);
+}
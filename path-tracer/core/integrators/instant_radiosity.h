@@ -0,0 +1,67 @@
+#pragma once
+#include <vector>
+#include "../core.h"
+#include "../alias_table.h"
+#include "../material.h"
+#include "../randomness.h"
+#include "../shading_context.h"
+
+class Camera;
+
+namespace integrators {
+
+  /**
+   * Instant radiosity, which gathers the indirect lighting at the first
+   * diffuse surface that the camera's paths reach from virtual point lights,
+   * left wherever light paths from its lights land.
+   */
+  class InstantRadiosity {
+    /** The number of light paths that leave virtual lights each iteration. */
+    static constexpr int PATHS = 256;
+    /** The number of virtual lights that each diffuse surface gathers from. */
+    static constexpr int SAMPLES = 16;
+    /**
+     * The distance below which virtual lights stop getting brighter, as a
+     * fraction of the focal length. This hides the bright spots around
+     * virtual lights at the cost of darkening corners.
+     */
+    static constexpr float MIN_DISTANCE = 0.05f;
+
+    /** Light that arrived at a diffuse surface, which it scatters onwards. */
+    struct VirtualLight {
+      Intersection isect; /**< Where the light arrived. */
+      const Material* mat; /**< The material of the surface. */
+      Vec direction; /**< The direction that the light arrived from. */
+      Vec power; /**< The power of the light, per light path traced. */
+    };
+
+    Camera& camera; /**< The camera whose lights leave the virtual lights. */
+    /** The virtual lights traced for the current iteration. */
+    std::vector<VirtualLight> virtualLights;
+    /** Power-weighted choice of virtual lights. */
+    AliasTable distribution;
+
+  public:
+    /**
+     * Constructs the integrator for the given camera, which must outlive it.
+     */
+    explicit InstantRadiosity(Camera& c);
+
+    /**
+     * Traces the light paths for the current iteration and leaves a virtual
+     * light wherever they land on a diffuse surface.
+     */
+    void traceVirtualLights();
+
+    /**
+     * Estimates the radiance reflected towards the incoming ray by a few of
+     * the virtual lights, chosen in proportion to their power.
+     *
+     * @param ctx the shading context of the surface that the ray struck
+     * @param rng the per-thread RNG in use
+     * @returns   the estimated radiance
+     */
+    Vec gather(const ShadingContext& ctx, Randomness& rng) const;
+  };
+
+}
@@ -0,0 +1,149 @@
+#include "metropolis.h"
+#include <algorithm>
+#include "../camera.h"
+
+integrators::Metropolis::Metropolis(Camera& c, size_t count)
+  : camera(c), chains(count), normalization(0.0f) {}
+
+void integrators::Metropolis::restart() {
+  normalization = 0.0f;
+}
+
+bool integrators::Metropolis::started() const {
+  return normalization > 0.0f;
+}
+
+Vec integrators::Metropolis::traceSamples(
+  Randomness& rng,
+  std::vector<float>* samples,
+  float* posXOut,
+  float* posYOut
+) const {
+  const Image& img = camera.img;
+  rng.replay(samples);
+  *posXOut = rng.nextFloat(-0.5f, float(img.w) - 0.5f);
+  *posYOut = rng.nextFloat(-0.5f, float(img.h) - 0.5f);
+  Vec L = camera.trace(camera.cameraRay(rng, *posXOut, *posYOut), rng);
+  rng.replay(nullptr);
+  return L;
+}
+
+void integrators::Metropolis::startChains() {
+  Randomness& rng = camera.masterRng;
+  double luminanceSum = 0.0;
+  std::vector<float> candidate;
+
+  for (Chain& chain : chains) {
+    // Keep one of the candidates, chosen in proportion to its luminance.
+    chain.samples.clear();
+    chain.radiance = Vec(0, 0, 0);
+    chain.posX = 0.0f;
+    chain.posY = 0.0f;
+
+    float chainLuminance = 0.0f;
+    for (int i = 0; i < BOOTSTRAP_SAMPLES; ++i) {
+      candidate.clear();
+      float posX;
+      float posY;
+      Vec L = traceSamples(rng, &candidate, &posX, &posY);
+
+      float luminance = math::luminance(L);
+      chainLuminance += luminance;
+      if (luminance > 0.0f
+          && rng.nextUnitFloat() * chainLuminance < luminance) {
+        chain.samples.swap(candidate);
+        chain.radiance = L;
+        chain.posX = posX;
+        chain.posY = posY;
+      }
+    }
+
+    chain.luminanceSum = chainLuminance;
+    chain.luminanceSamples = BOOTSTRAP_SAMPLES;
+    luminanceSum += chainLuminance;
+  }
+
+  normalization = float(
+    luminanceSum / double(chains.size() * BOOTSTRAP_SAMPLES)
+  );
+}
+
+void integrators::Metropolis::advanceChain(
+  size_t idx,
+  Randomness& rng,
+  long mutations
+) {
+  if (!started()) {
+    return;
+  }
+
+  Chain* chain = &chains[idx];
+  Image& img = camera.img;
+  std::vector<float> proposal;
+  float currentLuminance = math::luminance(chain->radiance);
+
+  for (long i = 0; i < mutations; ++i) {
+    // A large step starts over with fresh samples; a small step perturbs
+    // each sample, wrapping around within [0, 1).
+    proposal.clear();
+    bool largeStep = rng.nextUnitFloat() < LARGE_STEP_PROBABILITY;
+    if (!largeStep) {
+      for (float sample : chain->samples) {
+        sample += rng.nextNormalFloat() * SIGMA;
+        proposal.push_back(sample - floorf(sample));
+      }
+    }
+
+    float posX;
+    float posY;
+    Vec L = traceSamples(rng, &proposal, &posX, &posY);
+    float luminance = math::luminance(L);
+    if (largeStep) {
+      chain->luminanceSum += luminance;
+      chain->luminanceSamples++;
+    }
+
+    float accept = currentLuminance > 0.0f
+      ? std::min(1.0f, luminance / currentLuminance)
+      : 1.0f;
+
+    // Splat both paths by their expected share of the time, which is less
+    // noisy than splatting only the one that the chain ends up on.
+    if (luminance > 0.0f) {
+      img.addSplat(posX, posY, L * (accept * normalization / luminance));
+    }
+
+    if (currentLuminance > 0.0f) {
+      img.addSplat(
+        chain->posX,
+        chain->posY,
+        chain->radiance
+          * ((1.0f - accept) * normalization / currentLuminance)
+      );
+    }
+
+    if (rng.nextUnitFloat() < accept) {
+      chain->samples.swap(proposal);
+      chain->radiance = L;
+      chain->posX = posX;
+      chain->posY = posY;
+      currentLuminance = luminance;
+    }
+  }
+}
+
+void integrators::Metropolis::refineNormalization() {
+  if (!started()) {
+    return;
+  }
+
+  // Large steps are uniformly-chosen paths, so they refine the estimate of
+  // the average luminance.
+  double luminanceSum = 0.0;
+  long luminanceSamples = 0;
+  for (const Chain& chain : chains) {
+    luminanceSum += chain.luminanceSum;
+    luminanceSamples += chain.luminanceSamples;
+  }
+  normalization = float(luminanceSum / double(luminanceSamples));
+}
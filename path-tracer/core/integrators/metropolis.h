@@ -0,0 +1,105 @@
+#pragma once
+#include <vector>
+#include "../core.h"
+#include "../randomness.h"
+
+class Camera;
+
+namespace integrators {
+
+  /**
+   * Primary sample space Metropolis light transport, which runs Markov chains
+   * over the primary samples of the camera's path tracer and splats their
+   * paths onto its image.
+   */
+  class Metropolis {
+    /** The number of candidate paths that each Markov chain starts from. */
+    static constexpr int BOOTSTRAP_SAMPLES = 64;
+    /**
+     * The probability of proposing an entirely new path, rather than a small
+     * change to the current one.
+     */
+    static constexpr float LARGE_STEP_PROBABILITY = 0.3f;
+    /** The standard deviation of small changes to each primary sample. */
+    static constexpr float SIGMA = 0.01f;
+
+    /** The state of one of the Markov chains. */
+    struct Chain {
+      std::vector<float> samples; /**< The current path's primary samples. */
+      Vec radiance; /**< The radiance of the current path. */
+      float posX; /**< The film x-position of the current path. */
+      float posY; /**< The film y-position of the current path. */
+      /** The total luminance of the uniformly-chosen paths seen so far. */
+      double luminanceSum;
+      /** The number of uniformly-chosen paths seen so far. */
+      long luminanceSamples;
+    };
+
+    Camera& camera; /**< The camera that the paths are traced for. */
+    std::vector<Chain> chains; /**< The Markov chains. */
+    /**
+     * The average luminance of all paths, which scales the chains' samples;
+     * zero until the chains have been started. It is refined after each
+     * iteration using the chains' large steps.
+     */
+    float normalization;
+
+    /**
+     * Traces the path that the given primary samples stand for. The first
+     * samples choose the position on the film, and the rest are consumed by
+     * Camera::trace; any samples that are missing are generated and added.
+     *
+     * @param rng            the per-thread RNG in use
+     * @param samples        the primary samples to replay
+     * @param posXOut  [out] the film x-position of the path
+     * @param posYOut  [out] the film y-position of the path
+     * @returns              the sampled radiance of the path
+     */
+    Vec traceSamples(
+      Randomness& rng,
+      std::vector<float>* samples,
+      float* posXOut,
+      float* posYOut
+    ) const;
+
+  public:
+    /**
+     * Constructs the integrator for the given camera, which must outlive it.
+     *
+     * @param c     the camera
+     * @param count the number of Markov chains
+     */
+    Metropolis(Camera& c, size_t count);
+
+    /** Discards the chains, so that they start over from new paths. */
+    void restart();
+
+    /** Returns true if the chains have been started since the restart. */
+    bool started() const;
+
+    /**
+     * Estimates the average luminance of all paths, and starts each Markov
+     * chain from a path chosen in proportion to its luminance, so that the
+     * chains don't need to be run for a while before their samples are valid.
+     */
+    void startChains();
+
+    /**
+     * Advances a Markov chain, proposing changes to its path and splatting
+     * the results onto the image. Does nothing if the chains haven't been
+     * started.
+     *
+     * @param idx       the index of the chain
+     * @param rng       the per-thread RNG in use
+     * @param mutations the number of changes to propose
+     */
+    void advanceChain(size_t idx, Randomness& rng, long mutations);
+
+    /**
+     * Refines the average luminance of all paths after an iteration, using
+     * the uniformly-chosen paths that the chains proposed.
+     */
+    void refineNormalization();
+  };
+
+}
@@ -0,0 +1,100 @@
+#include "photon_mapping.h"
+#include "../camera.h"
+
+integrators::PhotonMapping::PhotonMapping(Camera& c)
+  : camera(c), photonMap(), radius(0.0f), photonsPerTask(0), buffers(TASKS),
+    seeds(TASKS) {}
+
+void integrators::PhotonMapping::restart() {
+  const Image& img = camera.img;
+  radius = RADIUS_PIXELS * camera.focalPlaneRight / float(img.w - 1);
+
+  // Trace about one photon per pixel each iteration.
+  photonsPerTask = (img.w * img.h + TASKS - 1) / TASKS;
+}
+
+void integrators::PhotonMapping::tracePhotons() {
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    seeds[i] = camera.masterRng.nextUnsigned();
+    buffers[i].clear();
+  }
+
+  camera.pool.dispatch(TASKS, &PhotonMapping::workFunc, this);
+
+  std::vector<PhotonMap::Photon> photons;
+  for (const std::vector<PhotonMap::Photon>& buffer : buffers) {
+    photons.insert(photons.end(), buffer.begin(), buffer.end());
+  }
+  photonMap.build(photons, radius);
+}
+
+void integrators::PhotonMapping::shrinkRadius(int iters) {
+  radius *= sqrtf((float(iters) + RADIUS_ALPHA) / (float(iters) + 1.0f));
+}
+
+Vec integrators::PhotonMapping::gather(const ShadingContext& ctx) const {
+  // Photons are evaluated in batches against the flat material table, which
+  // keeps the per-photon work a tight loop over local directions.
+  const MaterialTable& materials = camera.materials;
+  int matIdx = materials.indexOf(ctx.mat);
+  Vec directions[MaterialTable::BATCH_SIZE];
+  Vec powers[MaterialTable::BATCH_SIZE];
+  Vec bsdfs[MaterialTable::BATCH_SIZE];
+  float pdfs[MaterialTable::BATCH_SIZE];
+  size_t count = 0;
+
+  Vec sum(0, 0, 0);
+  auto flush = [&]() {
+    materials.evalBatch(
+      matIdx, ctx.incomingLocal, count, directions, bsdfs, pdfs
+    );
+    for (size_t i = 0; i < count; ++i) {
+      sum += bsdfs[i].cwiseProduct(powers[i]);
+    }
+    count = 0;
+  };
+
+  photonMap.lookup(ctx.isect.position, [&](const PhotonMap::Photon& photon) {
+    directions[count] = ctx.toLocal(photon.direction);
+    powers[count] = photon.power;
+    if (++count == MaterialTable::BATCH_SIZE) {
+      flush();
+    }
+  });
+  flush();
+
+  // Every photon traced this iteration counts towards the density estimate,
+  // including the ones that were never stored.
+  float lookupRadius = photonMap.lookupRadius();
+  float photonsEmitted = float(photonsPerTask * TASKS);
+  return sum / (math::PI * lookupRadius * lookupRadius * photonsEmitted);
+}
+
+void integrators::PhotonMapping::tracePhoton(
+  Randomness& rng,
+  std::vector<PhotonMap::Photon>* photonsOut
+) const {
+  camera.traceLightPath(rng, [&](
+    const LightRay& r,
+    const Intersection& isect,
+    const Material*,
+    int depth
+  ) {
+    // Light arriving straight from the lights is sampled directly instead.
+    if (depth > 0) {
+      photonsOut->push_back(
+        PhotonMap::Photon{isect.position, -r.direction, r.color}
+      );
+    }
+  });
+}
+
+void integrators::PhotonMapping::workFunc(int task_index, void* data) {
+  PhotonMapping* p = reinterpret_cast<PhotonMapping*>(data);
+  std::vector<PhotonMap::Photon>& photons = p->buffers[size_t(task_index)];
+
+  Randomness rng(p->seeds[size_t(task_index)]);
+  for (long i = 0; i < p->photonsPerTask; ++i) {
+    p->tracePhoton(rng, &photons);
+  }
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <vector>
+#include "../core.h"
+#include "../photon_map.h"
+#include "../randomness.h"
+#include "../shading_context.h"
+
+class Camera;
+
+namespace integrators {
+
+  /**
+   * Progressive photon mapping, which gathers the indirect lighting at the
+   * first diffuse surface that the camera's paths reach from photons traced
+   * from its lights. Each iteration traces new photons and gathers them over
+   * a smaller radius than the last.
+   */
+  class PhotonMapping {
+    /** The number of tasks that each iteration's photons are traced in. */
+    static constexpr int TASKS = 64;
+    /**
+     * The initial radius for gathering photons, in pixels on the focal plane.
+     */
+    static constexpr float RADIUS_PIXELS = 8.0f;
+    /**
+     * The fraction of the photons that are kept each time the gathering
+     * radius shrinks. Lower values shrink the radius faster, trading noise for
+     * bias.
+     */
+    static constexpr float RADIUS_ALPHA = 2.0f / 3.0f;
+
+    Camera& camera; /**< The camera whose lights emit the photons. */
+    PhotonMap photonMap; /**< The photons traced for the current iteration. */
+    float radius; /**< The current radius for gathering photons. */
+    long photonsPerTask; /**< The number of photons traced by each task. */
+    /** The photons stored by each task in the current iteration. */
+    std::vector<std::vector<PhotonMap::Photon>> buffers;
+    std::vector<unsigned> seeds; /**< The per-task RNG seeds. */
+
+    /**
+     * Emits a photon from a light chosen in proportion to its power, and
+     * stores it wherever it lands on a diffuse surface after at least one
+     * bounce. The first bounce is left to direct lighting.
+     *
+     * @param rng              the per-thread RNG in use
+     * @param photonsOut [out] the list to add the stored photons to
+     */
+    void tracePhoton(
+      Randomness& rng,
+      std::vector<PhotonMap::Photon>* photonsOut
+    ) const;
+
+    static void workFunc(int task_index, void* data);
+
+  public:
+    /**
+     * Constructs the integrator for the given camera, which must outlive it.
+     */
+    explicit PhotonMapping(Camera& c);
+
+    /**
+     * Starts over from the initial gathering radius, which is a few pixels'
+     * width of the camera's focal plane.
+     */
+    void restart();
+
+    /**
+     * Traces the photons for the current iteration in parallel and stores
+     * them in the photon map.
+     */
+    void tracePhotons();
+
+    /**
+     * Shrinks the gathering radius after an iteration, so that the average of
+     * the iterations converges (Knaus & Zwicker, "Progressive Photon Mapping:
+     * A Probabilistic Approach").
+     *
+     * @param iters the number of iterations done so far
+     */
+    void shrinkRadius(int iters);
+
+    /**
+     * Estimates the radiance reflected towards the incoming ray by the
+     * photons around the intersection.
+     *
+     * @param ctx the shading context of the surface that the ray struck
+     * @returns   the estimated radiance
+     */
+    Vec gather(const ShadingContext& ctx) const;
+  };
+
+}
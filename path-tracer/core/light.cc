@@ -1,98 +1,14 @@
 #include "light.h"
 #include "accelerator.h"
+#include "sd_tree.h"
 
 AreaLight::AreaLight(const Vec& c) : color(c) {}
 
 AreaLight::AreaLight(const Node& n) : AreaLight(n.getVec("color")) {}
 
-inline Vec AreaLight::directIlluminateByLightPDF(
-  Randomness& rng,
-  const Ray& incoming,
-  const Intersection& isect,
-  const Material* mat,
-  const Geom* emissionObj,
-  const Accelerator* accel
-) const {
-  // Sample random from light PDF.
-  Vec outgoingWorld;
-  Vec lightColor;
-  float lightPdf;
-  sampleLight(
-    rng,
-    accel,
-    emissionObj,
-    isect.position,
-    &outgoingWorld,
-    &lightColor,
-    &lightPdf
-  );
-
-  if (lightPdf > 0.0f && !math::isVectorExactlyZero(lightColor)) {
-    // Evaluate material BSDF and PDF as well.
-    Vec bsdf;
-    float bsdfPdf;
-    mat->evalWorld(
-      isect,
-      -incoming.direction,
-      outgoingWorld,
-      &bsdf,
-      &bsdfPdf
-    );
-
-    if (bsdfPdf > 0.0f && !math::isVectorExactlyZero(bsdf)) {
-      float lightWeight = math::powerHeuristic(1, lightPdf, 1, bsdfPdf);
-      return bsdf.cwiseProduct(lightColor)
-        * fabsf(isect.normal.dot(outgoingWorld))
-        * lightWeight / lightPdf;
-    }
-  }
-
-  return Vec(0, 0, 0);
-}
-
-inline Vec AreaLight::directIlluminateByMatPDF(
-  Randomness& rng,
-  const Ray& incoming,
-  const Intersection& isect,
-  const Material* mat,
-  const Geom* emissionObj,
-  const Accelerator* accel
-) const {
-  // Sample random from BSDF PDF.
-  Vec outgoingWorld;
-  Vec bsdf;
-  float bsdfPdf;
-  mat->sampleWorld(
-    isect,
-    rng,
-    -incoming.direction,
-    &outgoingWorld,
-    &bsdf,
-    &bsdfPdf
-  );
-
-  if (bsdfPdf > 0.0f && !math::isVectorExactlyZero(bsdf)) {
-    // Evaluate light PDF as well.
-    Vec lightColor;
-    float lightPdf;
-    evalLight(
-      accel,
-      emissionObj,
-      isect.position,
-      outgoingWorld,
-      &lightColor,
-      &lightPdf
-    );
-
-    if (lightPdf > 0.0f && !math::isVectorExactlyZero(lightColor)) {
-      float bsdfWeight = math::powerHeuristic(1, bsdfPdf, 1, lightPdf);
-      return bsdf.cwiseProduct(lightColor)
-        * fabsf(isect.normal.dot(outgoingWorld))
-        * bsdfWeight / bsdfPdf;
-    }
-  }
-
-  return Vec(0, 0, 0);
+float AreaLight::power(const Geom* emitter) const {
+  // A diffuse emitter radiates Pi * L per unit area into its hemisphere.
+  return math::PI * math::luminance(color) * emitter->area();
 }
 
 Vec AreaLight::emit(
@@ -128,51 +44,6 @@ Vec AreaLight::emit(
   return color;
 }
 
-void AreaLight::evalLight(
-  const Accelerator* accel,
-  const Geom* emissionObj,
-  const Vec& point,
-  const Vec& dirToLight,
-  Vec* colorOut,
-  float* pdfOut
-) const {
-  float pdf;
-  Vec emittedColor;
-
-  BSphere emitterBounds = emissionObj->boundSphere();
-  if (emitterBounds.contains(point)) {
-    // We're inside the bounding sphere, so sample sphere uniformly.
-    pdf = math::uniformSampleSpherePDF();
-  } else {
-    // We're outside the bounding sphere, so sample by solid angle.
-    Vec dirToLightOrigin = emitterBounds.origin - point;
-    float theta = asinf(emitterBounds.radius / dirToLightOrigin.norm());
-
-    Vec normal = dirToLightOrigin.normalized();
-    Vec tangent;
-    Vec binormal;
-    math::coordSystem(normal, &tangent, &binormal);
-
-    Vec dirToLightLocal =
-      math::worldToLocal(dirToLight, tangent, binormal, normal);
-    pdf = math::uniformSampleConePDF(theta, dirToLightLocal);
-  }
-
-  Ray pointToLight(point + math::VERY_SMALL * dirToLight, dirToLight);
-  Intersection lightIsect;
-  if (!emissionObj->intersect(pointToLight, &lightIsect)) {
-    // No emission if the ray doesn't hit the light
-    // (e.g. sampling doesn't exactly correspond with light).
-    emittedColor = Vec(0, 0, 0);
-  } else {
-    // Emits color if the ray does hit the light.
-    emittedColor = emit(pointToLight, lightIsect, accel);
-  }
-
-  *colorOut = emittedColor;
-  *pdfOut = pdf;
-}
-
 void AreaLight::sampleLight(
   Randomness& rng,
   const Accelerator* accel,
@@ -180,66 +51,99 @@ void AreaLight::sampleLight(
   const Vec& point,
   Vec* dirToLightOut,
   Vec* colorOut,
-  float* pdfOut
+  float* pdfOut,
+  float* distOut
 ) const {
-  Vec dirToLight;
+  Vec lightPoint;
+  Vec lightNormal;
   float pdf;
-  Vec emittedColor;
-
-  BSphere emitterBounds = emissionObj->boundSphere();
-  if (emitterBounds.contains(point)) {
-    // We're inside the bounding sphere, so sample sphere uniformly.
-    dirToLight = math::uniformSampleSphere(rng);
-    pdf = math::uniformSampleSpherePDF();
-  } else {
-    // We're outside the bounding sphere, so sample by solid angle.
-    Vec dirToLightOrigin = emitterBounds.origin - point;
-    float theta = asinf(emitterBounds.radius / dirToLightOrigin.norm());
-
-    Vec normal = dirToLightOrigin.normalized();
-    Vec tangent;
-    Vec binormal;
-    math::coordSystem(normal, &tangent, &binormal);
-
-    dirToLight = math::localToWorld(
-      math::uniformSampleCone(rng, theta),
-      tangent,
-      binormal,
-      normal
-    );
-    pdf = math::uniformSampleConePDF(theta);
+  if (!emissionObj->sampleSurface(
+        rng, point, &lightPoint, &lightNormal, &pdf) || pdf <= 0.0f) {
+    *dirToLightOut = Vec(0, 0, 0);
+    *colorOut = Vec(0, 0, 0);
+    *pdfOut = 0.0f;
+    if (distOut) {
+      *distOut = 0.0f;
+    }
+    return;
   }
 
-  Ray pointToLight(point + math::VERY_SMALL * dirToLight, dirToLight);
-  Intersection lightIsect;
-  if (!emissionObj->intersect(pointToLight, &lightIsect)) {
-    // No emission if the ray doesn't hit the light
-    // (e.g. sampling doesn't exactly correspond with light).
+  Vec dirToLight = lightPoint - point;
+  float dist = dirToLight.norm();
+  dirToLight = dirToLight / dist;
+
+  Vec emittedColor;
+  if (dirToLight.dot(lightNormal) > 0.0f) {
+    // Only emit on the normal-facing side of objects.
     emittedColor = Vec(0, 0, 0);
   } else {
-    // Emits color if the ray does hit the light.
-    emittedColor = emit(pointToLight, lightIsect, accel);
+    // Object might be occluded behind another object. The sampled point lies
+    // exactly on the light, so stop the shadow ray a little short of it; the
+    // relative term keeps distant lights from shadowing themselves.
+    Ray pointToLight(point + math::VERY_SMALL * dirToLight, dirToLight);
+    float maxDist =
+      (1.0f - math::VERY_SMALL) * dist - 2.0f * math::VERY_SMALL;
+    if (accel && accel->intersectShadow(pointToLight, maxDist)) {
+      emittedColor = Vec(0, 0, 0);
+    } else {
+      emittedColor = color;
+    }
   }
 
   *dirToLightOut = dirToLight;
   *colorOut = emittedColor;
   *pdfOut = pdf;
+  if (distOut) {
+    *distOut = dist;
+  }
 }
 
 Vec AreaLight::directIlluminate(
   Randomness& rng,
-  const Ray& incoming,
-  const Intersection& isect,
-  const Material* mat,
+  const ShadingContext& ctx,
   const Geom* emissionObj,
-  const Accelerator* accel
+  const Accelerator* accel,
+  float lightSelectPdf,
+  const DTree* guide,
+  float guideProb
 ) const {
-  Vec Ld(0, 0, 0);
-  
-  Ld +=
-    directIlluminateByLightPDF(rng, incoming, isect, mat, emissionObj, accel);
-  Ld +=
-    directIlluminateByMatPDF(rng, incoming, isect, mat, emissionObj, accel);
-
-  return Ld;
+  // Sample random from light PDF.
+  Vec outgoingWorld;
+  Vec lightColor;
+  float lightPdf;
+  sampleLight(
+    rng,
+    accel,
+    emissionObj,
+    ctx.isect.position,
+    &outgoingWorld,
+    &lightColor,
+    &lightPdf
+  );
+
+  if (lightPdf > 0.0f && !math::isVectorExactlyZero(lightColor)) {
+    // The light strategy also includes the choice of this emitter.
+    lightPdf *= lightSelectPdf;
+
+    // Evaluate material BSDF and PDF as well.
+    Vec bsdf;
+    float bsdfPdf;
+    ctx.mat->evalWorld(ctx, outgoingWorld, &bsdf, &bsdfPdf);
+
+    if (guide) {
+      // The path continues from a mixture of the material and the guide, so
+      // that is the strategy to weight against.
+      bsdfPdf = guideProb * guide->pdf(outgoingWorld)
+        + (1.0f - guideProb) * bsdfPdf;
+    }
+
+    if (!math::isVectorExactlyZero(bsdf)) {
+      float lightWeight = math::powerHeuristic(1, lightPdf, 1, bsdfPdf);
+      return bsdf.cwiseProduct(lightColor)
+        * fabsf(ctx.isect.normal.dot(outgoingWorld))
+        * lightWeight / lightPdf;
+    }
+  }
+
+  return Vec(0, 0, 0);
 }
@@ -5,45 +5,13 @@
 #include "node.h"
 
 class Accelerator;
+class DTree;
 
 /**
  * A diffuse area light that causes radiance to be emitted from a piece of
  * solid geometry.
  */
 class AreaLight {
-private:
-  /**
-   * Helper function for AreaLight::directIlluminate.
-   * Calculates only the weighted component of direct illumination according
-   * to the light's PDF.
-   * For help on parameters, see the documentation for
-   * AreaLight::directIlluminate.
-   */
-  inline Vec directIlluminateByLightPDF(
-    Randomness& rng,
-    const Ray& incoming,
-    const Intersection& isect,
-    const Material* mat,
-    const Geom* emitter,
-    const Accelerator* accel
-  ) const;
-
-  /**
-   * Helper function for AreaLight::directIlluminate.
-   * Calculates only the weighted component of direct illumination according
-   * to the material's PDF.
-   * For help on parameters, see the documentation for
-   * AreaLight::directIlluminate.
-   */
-  inline Vec directIlluminateByMatPDF(
-    Randomness& rng,
-    const Ray& incoming,
-    const Intersection& isect,
-    const Material* mat,
-    const Geom* emitter,
-    const Accelerator* accel
-  ) const;
-
 public:
   const Vec color; /**< The color of the light emitted. */
 
@@ -58,31 +26,14 @@ public:
   AreaLight(const Node& n);
 
   /**
-   * Evaluates the emittance from an emission object onto a given point via
-   * a specified direction. (Note that a diffuse area light can illuminate a
-   * point from multiple different directions.)
+   * Estimates the total power (flux) emitted by the light from the given
+   * emitter, as a luminance. This is suitable for choosing between lights in
+   * proportion to their contribution to the scene.
    *
-   * @param accel                the accelerator containing the scene geometry
-   * @param emitter              the geometry from which light is emitted
-   * @param point                the world-space point being illuminated by the
-   *                             emitter
-   * @param dirToLight           the direction from the world-space point
-   *                             towards the light for which illumination
-   *                             should be calculated
-   * @param colorOut       [out] the color the light emits
-   * @param pdfOut         [out] the probability that the light-sampling routine
-   *                             Material::sampleLight would have chosen the
-   *                             direction dirToLight to illuminate the
-   *                             world-space point
+   * @param emitter the geometry from which light is emitted
+   * @returns       the estimated emitted power
    */
-  void evalLight(
-    const Accelerator* accel,
-    const Geom* emitter,
-    const Vec& point,
-    const Vec& dirToLight,
-    Vec* colorOut,
-    float* pdfOut
-  ) const;
+  float power(const Geom* emitter) const;
 
   /**
    * Samples the emittance from the emission object onto a given point via a
@@ -90,7 +41,8 @@ public:
    * point from multiple different directions.)
    *
    * @param rng                  the per-thread RNG in use
-   * @param accel                the accelerator containing the scene geometry
+   * @param accel                the accelerator containing the scene geometry,
+   *                             or null to ignore occlusion
    * @param emitter              the geometry from which light is emitted
    * @param point                the world-space point being illuminated by the
    *                             emitter
@@ -99,6 +51,8 @@ public:
    * @param colorOut       [out] the color the light emits
    * @param pdfOut         [out] the probability of choosing the direction
    *                             dirToLight
+   * @param distOut        [out] if not null, the distance from the point to
+   *                             the sampled point on the emission object
    */
   void sampleLight(
     Randomness& rng,
@@ -107,7 +61,8 @@ public:
     const Vec& point,
     Vec* dirToLightOut,
     Vec* colorOut,
-    float* pdfOut
+    float* pdfOut,
+    float* distOut = nullptr
   ) const;
 
   /**
@@ -143,22 +98,33 @@ public:
    * geometry (the emitter) onto another piece of geometry (the reflector) at
    * the specified intersection point.
    *
+   * Only the light-sampling half of the multiple importance sampling estimate
+   * is computed here; it is weighted against the material's PDF, so the
+   * caller must add the matching material-sampling half when the path's next
+   * (BSDF-sampled) ray hits an emitter. See Camera::trace.
+   *
    * @param rng             the per-thread RNG in use
-   * @param incoming        the ray coming into the intersection on the target
-   *                        geometry (on the reflector)
-   * @param isect           the intersection on the target geometry that should
-   *                        be illuminated
-   * @param mat             the material of the target geometry being
-   *                        illuminated
+   * @param ctx             the shading context of the target geometry (the
+   *                        reflector) that should be illuminated
    * @param emitter         the object doing the illuminating (the emitter)
    * @param accel           the accelerator containing the scene geometry
+   * @param lightSelectPdf  the probability with which the emitter was chosen
+   *                        out of all of the scene's emitters; the result is
+   *                        scaled accordingly and the probability is taken
+   *                        into account when weighting the light sample
+   *                        against the material's PDF
+   * @param guide           the guiding distribution that the path continues
+   *                        from, or null if it only samples the material
+   * @param guideProb       the probability of continuing the path from the
+   *                        guiding distribution rather than the material
    */
   Vec directIlluminate(
     Randomness& rng,
-    const Ray& incoming,
-    const Intersection& isect,
-    const Material* mat,
+    const ShadingContext& ctx,
     const Geom* emitter,
-    const Accelerator* accel
+    const Accelerator* accel,
+    float lightSelectPdf = 1.0f,
+    const DTree* guide = nullptr,
+    float guideProb = 0.0f
   ) const;
 };
@@ -0,0 +1,251 @@
+#include "light_tree.h"
+#include <algorithm>
+#include "geom.h"
+#include "light.h"
+
+namespace {
+
+  /** Returns Cos[a - b] given the sines and cosines, clamped to 1 if b > a. */
+  inline float cosSubClamped(float sinA, float cosA, float sinB, float cosB) {
+    if (cosA > cosB) {
+      return 1.0f;
+    }
+    return cosA * cosB + sinA * sinB;
+  }
+
+  /** Returns Sin[a - b] given the sines and cosines, clamped to 0 if b > a. */
+  inline float sinSubClamped(float sinA, float cosA, float sinB, float cosB) {
+    if (cosA > cosB) {
+      return 0.0f;
+    }
+    return sinA * cosB - cosA * sinB;
+  }
+
+  /** Returns Sqrt[1 - x^2], guarding against rounding error. */
+  inline float sinFromCos(float x) {
+    return sqrtf(max(0.0f, 1.0f - x * x));
+  }
+
+}
+
+LightTree::LightBounds::LightBounds()
+  : bounds(), power(0.0f), axis(0, 0, 1), cosThetaO(1.0f), cosThetaE(1.0f) {}
+
+float LightTree::LightBounds::importance(const Vec& p, const Vec& n) const {
+  if (power <= 0.0f) {
+    return 0.0f;
+  }
+
+  // Clamp the distance to the size of the bounds so that points close to or
+  // inside of a large emitter don't get an unbounded importance.
+  BSphere bs(bounds);
+  Vec toPoint = p - bs.origin;
+  float d2 = max(toPoint.squaredNorm(), bs.radius * bs.radius);
+  float dist = toPoint.norm();
+  Vec wi = dist > 0.0f ? Vec(toPoint / dist) : Vec(axis);
+
+  // Bound the angle subtended by the bounds at the point.
+  float cosThetaB;
+  if (bs.contains(p)) {
+    cosThetaB = -1.0f;
+  } else {
+    float sin2ThetaB = (bs.radius * bs.radius) / toPoint.squaredNorm();
+    cosThetaB = sqrtf(max(0.0f, 1.0f - sin2ThetaB));
+  }
+  float sinThetaB = sinFromCos(cosThetaB);
+
+  // Find the smallest possible angle between an emitting normal and the
+  // direction to the point; no light is emitted beyond thetaE of a normal.
+  float cosThetaW = axis.dot(wi);
+  float sinThetaW = sinFromCos(cosThetaW);
+  float sinThetaO = sinFromCos(cosThetaO);
+  float cosThetaX = cosSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+  float sinThetaX = sinSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+  float cosThetaP = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+  if (cosThetaP <= cosThetaE) {
+    return 0.0f;
+  }
+
+  float result = power * cosThetaP / d2;
+
+  // Account for the foreshortening at the receiving surface.
+  if (!math::isVectorExactlyZero(n)) {
+    float cosThetaI = fabsf(wi.dot(n));
+    float sinThetaI = sinFromCos(cosThetaI);
+    result *= cosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+  }
+
+  return max(0.0f, result);
+}
+
+LightTree::LightBounds LightTree::LightBounds::merge(
+  const LightBounds& a,
+  const LightBounds& b
+) {
+  LightBounds result;
+  result.bounds = a.bounds;
+  result.bounds.expand(b.bounds);
+  result.power = a.power + b.power;
+  result.cosThetaE = min(a.cosThetaE, b.cosThetaE);
+
+  // Find the smallest cone containing both normal cones.
+  float thetaA = acosf(math::clamp(a.cosThetaO, -1.0f, 1.0f));
+  float thetaB = acosf(math::clamp(b.cosThetaO, -1.0f, 1.0f));
+  float thetaD = acosf(math::clamp(a.axis.dot(b.axis), -1.0f, 1.0f));
+
+  if (min(thetaD + thetaB, math::PI) <= thetaA) {
+    result.axis = a.axis;
+    result.cosThetaO = a.cosThetaO;
+  } else if (min(thetaD + thetaA, math::PI) <= thetaB) {
+    result.axis = b.axis;
+    result.cosThetaO = b.cosThetaO;
+  } else {
+    float thetaO = 0.5f * (thetaA + thetaD + thetaB);
+    Vec rotAxis = a.axis.cross(b.axis);
+    if (thetaO >= math::PI || math::isNearlyZero(rotAxis)) {
+      result.axis = a.axis;
+      result.cosThetaO = -1.0f;
+    } else {
+      Transform rot = math::rotation(thetaO - thetaA, rotAxis.normalized());
+      result.axis = (rot.linear() * a.axis).normalized();
+      result.cosThetaO = cosf(thetaO);
+    }
+  }
+
+  return result;
+}
+
+LightTree::LightTree() : nodes(), leafOf() {}
+
+LightTree::LightTree(const std::vector<const Geom*>& emitters)
+  : nodes(), leafOf(emitters.size(), -1)
+{
+  if (emitters.empty()) {
+    return;
+  }
+
+  std::vector<LightBounds> bounds(emitters.size());
+  std::vector<int> indices(emitters.size());
+  for (size_t i = 0; i < emitters.size(); ++i) {
+    const Geom* g = emitters[i];
+    LightBounds& lb = bounds[i];
+    lb.bounds = g->boundBox();
+    lb.power = g->light->power(g);
+    g->boundNormals(&lb.axis, &lb.cosThetaO);
+    lb.cosThetaE = 0.0f; // Diffuse emission reaches Pi / 2 from the normal.
+    indices[i] = int(i);
+  }
+
+  nodes.reserve(2 * emitters.size() - 1);
+  build(bounds, indices, 0, indices.size(), -1);
+}
+
+int LightTree::build(
+  const std::vector<LightBounds>& bounds,
+  std::vector<int>& indices,
+  size_t start,
+  size_t end,
+  int parent
+) {
+  int nodeIdx = int(nodes.size());
+  nodes.push_back(Node());
+  nodes[nodeIdx].parent = parent;
+
+  if (end - start == 1) {
+    int emitterIdx = indices[start];
+    nodes[nodeIdx].lb = bounds[emitterIdx];
+    nodes[nodeIdx].secondChild = -1;
+    nodes[nodeIdx].emitterIdx = emitterIdx;
+    leafOf[emitterIdx] = nodeIdx;
+    return nodeIdx;
+  }
+
+  // Split at the median centroid along the longest axis of the centroids.
+  auto centroid = [&](int i) {
+    return Vec((bounds[i].bounds.lower + bounds[i].bounds.upper) * 0.5f);
+  };
+  BBox centroidBounds(centroid(indices[start]), centroid(indices[start]));
+  for (size_t i = start + 1; i < end; ++i) {
+    centroidBounds.expand(centroid(indices[i]));
+  }
+  axis splitAxis = centroidBounds.maximumExtent();
+
+  size_t mid = (start + end) / 2;
+  std::nth_element(
+    indices.begin() + long(start),
+    indices.begin() + long(mid),
+    indices.begin() + long(end),
+    [&](int a, int b) {
+      return centroid(a)[splitAxis] < centroid(b)[splitAxis];
+    }
+  );
+
+  int first = build(bounds, indices, start, mid, nodeIdx);
+  int second = build(bounds, indices, mid, end, nodeIdx);
+
+  nodes[nodeIdx].lb = LightBounds::merge(nodes[first].lb, nodes[second].lb);
+  nodes[nodeIdx].secondChild = second;
+  nodes[nodeIdx].emitterIdx = -1;
+  return nodeIdx;
+}
+
+int LightTree::sample(
+  Randomness& rng,
+  const Vec& p,
+  const Vec& n,
+  float* pdfOut
+) const {
+  *pdfOut = 0.0f;
+  if (nodes.empty()) {
+    return -1;
+  }
+
+  int nodeIdx = 0;
+  float pdf = 1.0f;
+  while (nodes[nodeIdx].secondChild >= 0) {
+    int first = nodeIdx + 1;
+    int second = nodes[nodeIdx].secondChild;
+    float i0 = nodes[first].lb.importance(p, n);
+    float i1 = nodes[second].lb.importance(p, n);
+    if (i0 <= 0.0f && i1 <= 0.0f) {
+      return -1;
+    }
+
+    float p0 = i0 / (i0 + i1);
+    if (rng.nextUnitFloat() < p0) {
+      nodeIdx = first;
+      pdf *= p0;
+    } else {
+      nodeIdx = second;
+      pdf *= 1.0f - p0;
+    }
+  }
+
+  *pdfOut = pdf;
+  return nodes[nodeIdx].emitterIdx;
+}
+
+float LightTree::pdf(const Vec& p, const Vec& n, int emitterIdx) const {
+  if (nodes.empty()) {
+    return 0.0f;
+  }
+
+  // Walk up from the leaf, multiplying the probability of each choice.
+  float pdf = 1.0f;
+  int nodeIdx = leafOf[emitterIdx];
+  while (nodes[nodeIdx].parent >= 0) {
+    int parentIdx = nodes[nodeIdx].parent;
+    int first = parentIdx + 1;
+    int second = nodes[parentIdx].secondChild;
+    float i0 = nodes[first].lb.importance(p, n);
+    float i1 = nodes[second].lb.importance(p, n);
+    if (i0 <= 0.0f && i1 <= 0.0f) {
+      return 0.0f;
+    }
+
+    pdf *= (nodeIdx == first ? i0 : i1) / (i0 + i1);
+    nodeIdx = parentIdx;
+  }
+
+  return pdf;
+}
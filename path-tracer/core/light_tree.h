@@ -0,0 +1,117 @@
+#pragma once
+#include <vector>
+#include "core.h"
+
+class Geom;
+
+/**
+ * A bounding volume hierarchy over a set of emitters, used to choose a light
+ * for direct illumination in proportion to its estimated contribution at a
+ * particular shading point. Each node bounds the position, total power, and
+ * emission directions of the emitters beneath it; sampling walks from the
+ * root to a leaf, choosing between the two children of each node according to
+ * their estimated importance, so that choosing a light costs O(log L).
+ *
+ * See Conty Estevez & Kulla, "Importance Sampling of Many Lights with Adaptive
+ * Tree Splitting" (HPG 2018), and Pharr, Jakob & Humphreys' PBR (4th ed.),
+ * section 12.6.3, for the importance heuristic used here.
+ */
+class LightTree {
+  /**
+   * The spatial and directional bounds of one or more emitters.
+   */
+  struct LightBounds {
+    BBox bounds; /**< The bounds of the emitting surfaces. */
+    float power; /**< The total power emitted. */
+    Vec axis; /**< The central axis of the cone of surface normals. */
+    float cosThetaO; /**< Cosine of the normal cone's half-angle. */
+    float cosThetaE; /**< Cosine of the emission half-angle about a normal. */
+
+    LightBounds();
+
+    /**
+     * Estimates the contribution of the bounded emitters at a point.
+     *
+     * @param p the point being illuminated
+     * @param n the surface normal at the point, or zero if unknown
+     * @returns the (unnormalized) importance of the bounded emitters
+     */
+    float importance(const Vec& p, const Vec& n) const;
+
+    /** Returns bounds containing both of the given bounds. */
+    static LightBounds merge(const LightBounds& a, const LightBounds& b);
+  };
+
+  /**
+   * A node in the flattened tree. The first child of an interior node
+   * immediately follows it in the node list.
+   */
+  struct Node {
+    LightBounds lb; /**< The bounds of the emitters under this node. */
+    int parent; /**< Index of the parent node, or -1 for the root. */
+    int secondChild; /**< Index of the second child, or -1 for a leaf. */
+    int emitterIdx; /**< Index of the emitter for a leaf, otherwise -1. */
+  };
+
+  std::vector<Node> nodes; /**< The nodes, in depth-first order. */
+  std::vector<int> leafOf; /**< The leaf node index of each emitter. */
+
+  /**
+   * Recursively builds the subtree containing the given emitters.
+   *
+   * @param bounds  the bounds of every emitter
+   * @param indices the emitters to put in this subtree; will be reordered
+   * @param start   the first index (inclusive) in indices to use
+   * @param end     the last index (exclusive) in indices to use
+   * @param parent  the index of the parent node, or -1 for the root
+   * @returns       the index of the subtree's root node
+   */
+  int build(
+    const std::vector<LightBounds>& bounds,
+    std::vector<int>& indices,
+    size_t start,
+    size_t end,
+    int parent
+  );
+
+public:
+  /**
+   * Constructs an empty tree. Sampling an empty tree never chooses a light.
+   */
+  LightTree();
+
+  /**
+   * Constructs a tree over the given emitters.
+   *
+   * @param emitters the emitters; each must have a light
+   */
+  LightTree(const std::vector<const Geom*>& emitters);
+
+  /** Returns true if the tree contains no emitters. */
+  inline bool empty() const { return nodes.empty(); }
+
+  /**
+   * Chooses an emitter to illuminate the given point.
+   *
+   * @param rng          the per-thread RNG in use
+   * @param p            the point being illuminated
+   * @param n            the surface normal at the point, or zero if unknown
+   * @param pdfOut [out] the probability of choosing the returned emitter;
+   *                     the pointer must not be null
+   * @returns            the index of the chosen emitter in the list the tree
+   *                     was built from, or -1 if no emitter can illuminate
+   *                     the point
+   */
+  int sample(Randomness& rng, const Vec& p, const Vec& n, float* pdfOut) const;
+
+  /**
+   * Returns the probability that LightTree::sample would choose the given
+   * emitter to illuminate the given point.
+   *
+   * @param p          the point being illuminated
+   * @param n          the surface normal at the point, or zero if unknown
+   * @param emitterIdx the index of the emitter in the list the tree was built
+   *                   from
+   */
+  float pdf(const Vec& p, const Vec& n, int emitterIdx) const;
+};
@@ -0,0 +1,4 @@
+#pragma once
+#include "distant.h"
+#include "environment.h"
+#include "occluded.h"
@@ -0,0 +1,73 @@
+#include "distant.h"
+#include "../geom.h"
+#include "../light.h"
+
+lights::Distant::Distant(const Vec& dir, float angle, const Vec& c)
+  : axis(dir.normalized()), halfAngle(angle), cosHalfAngle(cosf(angle)),
+    color(c) {}
+
+lights::Distant* lights::Distant::fromEmitter(
+  const Geom* emitter,
+  const BSphere& receivers,
+  float tolerance
+) {
+  // Only a sphere looks like a uniformly-lit cone from every direction.
+  if (!emitter->light || !emitter->isSpherical()) {
+    return nullptr;
+  }
+
+  BSphere bounds = emitter->boundSphere();
+  if (variation(bounds, receivers) > tolerance) {
+    return nullptr;
+  }
+
+  Vec toLight = bounds.origin - receivers.origin;
+  return new Distant(
+    toLight,
+    asinf(bounds.radius / toLight.norm()),
+    emitter->light->color
+  );
+}
+
+Vec lights::Distant::emit(const Vec& dir) const {
+  if (!covers(dir)) {
+    return Vec(0, 0, 0);
+  }
+
+  return color;
+}
+
+void lights::Distant::sampleDirection(
+  Randomness& rng,
+  Vec* dirOut,
+  Vec* colorOut,
+  float* pdfOut
+) const {
+  Vec tangent;
+  Vec binormal;
+  math::coordSystem(axis, &tangent, &binormal);
+
+  *dirOut = math::localToWorld(
+    math::uniformSampleCone(rng, halfAngle),
+    tangent,
+    binormal,
+    axis
+  );
+  *colorOut = color;
+  *pdfOut = math::uniformSampleConePDF(halfAngle);
+}
+
+float lights::Distant::pdf(const Vec& dir) const {
+  if (!covers(dir)) {
+    return 0.0f;
+  }
+
+  return math::uniformSampleConePDF(halfAngle);
+}
+
+float lights::Distant::power(const BSphere& sceneBounds) const {
+  // The irradiance from the cone, falling on a disc of the scene's radius.
+  float solidAngle = 1.0f / math::uniformSampleConePDF(halfAngle);
+  float r = sceneBounds.radius;
+  return math::luminance(color) * solidAngle * math::PI * r * r;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include "../infinite_light.h"
+
+class Geom;
+
+namespace lights {
+
+  /**
+   * A light so far away that it subtends the same cone of directions from
+   * every point in the scene, such as the sun. It is evaluated analytically
+   * and never needs to be intersected.
+   */
+  class Distant : public InfiniteLight {
+    const Vec axis; /**< The direction from the scene towards the light. */
+    const float halfAngle; /**< The half-angle of the cone, in radians. */
+    const float cosHalfAngle; /**< The cosine of Distant::halfAngle. */
+    const Vec color; /**< The radiance arriving from within the cone. */
+
+  public:
+    /**
+     * The largest relative variation, across the scene, in the size and
+     * direction of an emitter that the camera replaces by a distant light.
+     * The lower this value, the farther away an emitter must be to be
+     * replaced.
+     */
+    static constexpr float TOLERANCE = 0.05f;
+
+    /**
+     * Constructs a distant light.
+     *
+     * @param dir       the direction from the scene towards the light
+     * @param angle     the half-angle of the cone subtended by the light
+     * @param c         the radiance arriving from within the cone
+     */
+    Distant(const Vec& dir, float angle, const Vec& c);
+
+    /**
+     * Measures how much a spherical emitter changes across the receivers, as
+     * the larger of the relative variation in the solid angle that it
+     * subtends and the shift in its direction relative to its angular size.
+     * An emitter can be replaced if this is within the tolerance.
+     *
+     * @param emitter   the bounds of the emitter
+     * @param receivers bounds containing all of the geometry that the emitter
+     *                  illuminates
+     * @returns         the variation, or math::VERY_BIG if some receivers are
+     *                  too close to (or inside) the emitter
+     */
+    static inline float variation(
+      const BSphere& emitter,
+      const BSphere& receivers
+    ) {
+      float d = (emitter.origin - receivers.origin).norm();
+      float r = emitter.radius;
+      float rr = receivers.radius;
+      if (d - rr <= r) {
+        return math::VERY_BIG;
+      }
+
+      // The solid angle subtended by the sphere goes as Sin[Theta]^2 =
+      // (r / d)^2, so compare it at the nearest and farthest receiving
+      // points. Moving around the receivers shifts the direction of the
+      // emitter by up to rr / d, compared to its angular radius r / d.
+      float solidAngleRatio = ((d + rr) * (d + rr)) / ((d - rr) * (d - rr));
+      return max(solidAngleRatio - 1.0f, rr / r);
+    }
+
+    /**
+     * Creates a distant light that stands in for a spherical emitter, if the
+     * emitter is far enough away that its apparent size and direction are
+     * nearly the same from everywhere in the given bounds.
+     *
+     * @param emitter   the emitter to replace
+     * @param receivers bounds containing all of the geometry that the emitter
+     *                  illuminates
+     * @param tolerance the largest allowed variation across the bounds; see
+     *                  Distant::variation
+     * @returns         a new distant light owned by the caller, or null if the
+     *                  emitter can't be replaced
+     */
+    static Distant* fromEmitter(
+      const Geom* emitter,
+      const BSphere& receivers,
+      float tolerance
+    );
+
+    /** Returns whether the given direction lies within the light's cone. */
+    inline bool covers(const Vec& dir) const {
+      return dir.dot(axis) >= cosHalfAngle;
+    }
+
+    virtual Vec emit(const Vec& dir) const override;
+    virtual void sampleDirection(
+      Randomness& rng,
+      Vec* dirOut,
+      Vec* colorOut,
+      float* pdfOut
+    ) const override;
+    virtual float pdf(const Vec& dir) const override;
+    virtual float power(const BSphere& sceneBounds) const override;
+  };
+
+}
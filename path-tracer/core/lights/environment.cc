@@ -0,0 +1,188 @@
+#include "environment.h"
+#include <fstream>
+#include <boost/format.hpp>
+
+using boost::format;
+
+lights::Environment::Environment(const Vec& c)
+  : color(c), width(0), height(0), pixels(), distribution() {}
+
+lights::Environment::Environment(const std::string& fileName, const Vec& scale)
+  : color(scale), width(0), height(0), pixels(), distribution()
+{
+  readPFM(fileName);
+  initDistribution();
+}
+
+lights::Environment::Environment(const Node& n)
+  : lights::Environment(n.getVec("color"))
+{
+  const std::string fileName = n.getString("image");
+  if (fileName.length() != 0) {
+    readPFM(fileName);
+    initDistribution();
+  }
+}
+
+void lights::Environment::readPFM(const std::string& fileName) {
+  std::ifstream file(fileName, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error(str(format("Cannot open image '%1%'") % fileName));
+  }
+
+  // The header is "PF" (color) or "Pf" (grayscale), the dimensions, and a
+  // scale whose sign gives the byte order.
+  std::string magic;
+  long w;
+  long h;
+  float endianScale;
+  file >> magic >> w >> h >> endianScale;
+  file.get(); // Single whitespace character before the data.
+
+  if (!file || (magic != "PF" && magic != "Pf") || w <= 0 || h <= 0) {
+    throw std::runtime_error(str(format("Cannot read image '%1%'") % fileName));
+  }
+
+  const int channels = magic == "PF" ? 3 : 1;
+  const bool fileLittleEndian = endianScale < 0.0f;
+  const uint16_t probe = 1;
+  const bool hostLittleEndian = *reinterpret_cast<const uint8_t*>(&probe) == 1;
+
+  std::vector<float> data(size_t(w * h * channels));
+  file.read(
+    reinterpret_cast<char*>(data.data()),
+    std::streamsize(data.size() * sizeof(float))
+  );
+  if (!file) {
+    throw std::runtime_error(
+      str(format("Image '%1%' is truncated") % fileName)
+    );
+  }
+
+  if (fileLittleEndian != hostLittleEndian) {
+    for (float& f : data) {
+      uint8_t* bytes = reinterpret_cast<uint8_t*>(&f);
+      std::swap(bytes[0], bytes[3]);
+      std::swap(bytes[1], bytes[2]);
+    }
+  }
+
+  // PFM rows are stored from the bottom up.
+  width = w;
+  height = h;
+  pixels.resize(size_t(w * h));
+  for (long y = 0; y < h; ++y) {
+    for (long x = 0; x < w; ++x) {
+      const float* px = &data[size_t(((h - 1 - y) * w + x) * channels)];
+      Vec c = channels == 3
+        ? Vec(px[0], px[1], px[2])
+        : Vec(px[0], px[0], px[0]);
+      pixels[size_t(y * w + x)] = c.cwiseProduct(color);
+    }
+  }
+}
+
+void lights::Environment::initDistribution() {
+  // Weight each pixel by the solid angle it covers, which shrinks towards the
+  // poles of the sphere.
+  std::vector<float> weights(pixels.size());
+  for (long y = 0; y < height; ++y) {
+    float sinTheta = sinf(math::PI * (float(y) + 0.5f) / float(height));
+    for (long x = 0; x < width; ++x) {
+      size_t idx = size_t(y * width + x);
+      weights[idx] = max(0.0f, math::luminance(pixels[idx])) * sinTheta;
+    }
+  }
+
+  distribution.reset(
+    new Distribution2D(weights.data(), size_t(width), size_t(height))
+  );
+}
+
+const Vec& lights::Environment::lookup(const Vec2& uv) const {
+  long x = math::clampAny(long(uv.x() * float(width)), 0l, width - 1);
+  long y = math::clampAny(long(uv.y() * float(height)), 0l, height - 1);
+  return pixels[size_t(y * width + x)];
+}
+
+Vec2 lights::Environment::directionToUV(const Vec& dir) {
+  float theta = acosf(math::clamp(dir.y(), -1.0f, 1.0f));
+  float phi = atan2f(dir.z(), dir.x());
+  if (phi < 0.0f) {
+    phi += math::TWO_PI;
+  }
+  return Vec2(phi / math::TWO_PI, theta / math::PI);
+}
+
+Vec lights::Environment::emit(const Vec& dir) const {
+  if (!distribution) {
+    return color;
+  }
+
+  return lookup(directionToUV(dir));
+}
+
+void lights::Environment::sampleDirection(
+  Randomness& rng,
+  Vec* dirOut,
+  Vec* colorOut,
+  float* pdfOut
+) const {
+  if (!distribution) {
+    *dirOut = math::uniformSampleSphere(rng);
+    *colorOut = color;
+    *pdfOut = math::uniformSampleSpherePDF();
+    return;
+  }
+
+  float uvPdf;
+  Vec2 uv = distribution->sampleContinuous(rng, &uvPdf);
+
+  float theta = uv.y() * math::PI;
+  float phi = uv.x() * math::TWO_PI;
+  float sinTheta = sinf(theta);
+  *dirOut = Vec(sinTheta * cosf(phi), cosf(theta), sinTheta * sinf(phi));
+  *colorOut = lookup(uv);
+
+  // Convert from a density over the image to a density over solid angle.
+  *pdfOut = sinTheta > 0.0f
+    ? uvPdf / (2.0f * math::PI * math::PI * sinTheta)
+    : 0.0f;
+}
+
+float lights::Environment::pdf(const Vec& dir) const {
+  if (!distribution) {
+    return math::uniformSampleSpherePDF();
+  }
+
+  float sinTheta = sqrtf(max(0.0f, 1.0f - dir.y() * dir.y()));
+  if (sinTheta <= 0.0f) {
+    return 0.0f;
+  }
+
+  Vec2 uv = directionToUV(dir);
+  return distribution->pdf(uv) / (2.0f * math::PI * math::PI * sinTheta);
+}
+
+float lights::Environment::power(const BSphere& sceneBounds) const {
+  // The light arriving from all directions at a disc of the scene's radius.
+  float average;
+  if (!distribution) {
+    average = math::luminance(color);
+  } else {
+    double sum = 0.0;
+    double solidAngle = 0.0;
+    for (long y = 0; y < height; ++y) {
+      float sinTheta = sinf(math::PI * (float(y) + 0.5f) / float(height));
+      for (long x = 0; x < width; ++x) {
+        const Vec& px = pixels[size_t(y * width + x)];
+        sum += double(math::luminance(px) * sinTheta);
+        solidAngle += double(sinTheta);
+      }
+    }
+    average = solidAngle > 0.0 ? float(sum / solidAngle) : 0.0f;
+  }
+
+  float r = sceneBounds.radius;
+  return math::FOUR_PI * math::PI * r * r * average;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "../infinite_light.h"
+#include "../distribution.h"
+#include "../node.h"
+
+namespace lights {
+
+  /**
+   * An environment (dome) light that surrounds the entire scene. It either
+   * emits a constant color in every direction, or emits the colors of a
+   * latitude-longitude (equirectangular) HDR image, in which case directions
+   * are importance-sampled according to the brightness of the image.
+   *
+   * The +Y axis points towards the top row of the image, which spans the
+   * full circle of longitude.
+   */
+  class Environment : public InfiniteLight {
+    const Vec color; /**< The constant color, or the image's scale factor. */
+    long width; /**< The width of the image, or 0 if there is no image. */
+    long height; /**< The height of the image, or 0 if there is no image. */
+    std::vector<Vec> pixels; /**< The image's pixels in row-major order. */
+    /** Distribution over the image, weighted by luminance * Sin[Theta]. */
+    std::unique_ptr<Distribution2D> distribution;
+
+    /**
+     * Reads a PFM (portable float map) image.
+     *
+     * @throws std::runtime_error if the image could not be read
+     */
+    void readPFM(const std::string& fileName);
+
+    /** Builds the sampling distribution once the pixels are loaded. */
+    void initDistribution();
+
+    /** Returns the image pixel containing the given image coordinates. */
+    const Vec& lookup(const Vec2& uv) const;
+
+    /** Converts a direction to image coordinates in [0, 1)^2. */
+    static Vec2 directionToUV(const Vec& dir);
+
+  public:
+    /**
+     * Constructs an environment that emits a constant color.
+     *
+     * @param c the color emitted from every direction
+     */
+    Environment(const Vec& c);
+
+    /**
+     * Constructs an environment from a latitude-longitude PFM image.
+     *
+     * @param fileName the name of the PFM file to read
+     * @param scale    a color multiplied with every pixel of the image
+     *
+     * @throws std::runtime_error if the image could not be read
+     */
+    Environment(const std::string& fileName, const Vec& scale);
+
+    /**
+     * Constructs an environment from the given node. If the node's image is
+     * empty, a constant color is used.
+     */
+    Environment(const Node& n);
+
+    virtual Vec emit(const Vec& dir) const override;
+    virtual void sampleDirection(
+      Randomness& rng,
+      Vec* dirOut,
+      Vec* colorOut,
+      float* pdfOut
+    ) const override;
+    virtual float pdf(const Vec& dir) const override;
+    virtual float power(const BSphere& sceneBounds) const override;
+  };
+
+}
@@ -0,0 +1,44 @@
+#include "occluded.h"
+
+lights::Occluded::Occluded(
+  const InfiniteLight* b,
+  const std::vector<const Distant*>& o
+) : behind(b), occluders(o) {}
+
+bool lights::Occluded::occluded(const Vec& dir) const {
+  for (const Distant* d : occluders) {
+    if (d->covers(dir)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+Vec lights::Occluded::emit(const Vec& dir) const {
+  if (occluded(dir)) {
+    return Vec(0, 0, 0);
+  }
+
+  return behind->emit(dir);
+}
+
+void lights::Occluded::sampleDirection(
+  Randomness& rng,
+  Vec* dirOut,
+  Vec* colorOut,
+  float* pdfOut
+) const {
+  behind->sampleDirection(rng, dirOut, colorOut, pdfOut);
+  if (occluded(*dirOut)) {
+    *colorOut = Vec(0, 0, 0);
+  }
+}
+
+float lights::Occluded::pdf(const Vec& dir) const {
+  return behind->pdf(dir);
+}
+
+float lights::Occluded::power(const BSphere& sceneBounds) const {
+  return behind->power(sceneBounds);
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include "../infinite_light.h"
+#include "distant.h"
+
+namespace lights {
+
+  /**
+   * An infinite light with distant lights in front of it, such as the sky
+   * behind the sun. Directions within any of their cones see the distant
+   * light instead, so they get no radiance from the light behind.
+   */
+  class Occluded : public InfiniteLight {
+    const InfiniteLight* behind; /**< The light being occluded. */
+    std::vector<const Distant*> occluders; /**< The lights in front. */
+
+    /** Returns whether any of the occluders covers the given direction. */
+    bool occluded(const Vec& dir) const;
+
+  public:
+    /**
+     * Constructs an occluded light.
+     *
+     * @param b the light being occluded, which must outlive this one
+     * @param o the distant lights in front of it
+     */
+    Occluded(const InfiniteLight* b, const std::vector<const Distant*>& o);
+
+    virtual Vec emit(const Vec& dir) const override;
+    /**
+     * Samples the light behind, occluded or not, so that the PDF stays the
+     * same; a direction within an occluder gets no radiance.
+     */
+    virtual void sampleDirection(
+      Randomness& rng,
+      Vec* dirOut,
+      Vec* colorOut,
+      float* pdfOut
+    ) const override;
+    virtual float pdf(const Vec& dir) const override;
+    /** Returns the power of the light behind, ignoring the occluders. */
+    virtual float power(const BSphere& sceneBounds) const override;
+  };
+
+}
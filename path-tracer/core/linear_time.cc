@@ -1,8 +1,150 @@
 #include "linear_time.h"
 #include "core.h"
+#include "cpu_dispatch.h"
 #include "geom.h"
 
-LinearTime::LinearTime(const std::vector<const Geom*>& o) : objs(o) {}
+namespace {
+
+  /**
+   * Sweeps the sphere packets a bundle of W lanes at a time, keeping the
+   * closest hit seen in each lane; see LinearTime::SphereKernel.
+   *
+   * Eigen picks its packet width when the file is compiled, not per target,
+   * and has no vector form of select. So the lanes are written out one
+   * coefficient at a time, branch-free, and the compiler vectorizes them
+   * into one register of W floats in each target.
+   */
+  template<int W>
+  CPU_KERNEL size_t sweepSpheres(
+    const LinearTime::SpherePackets& packets,
+    const Ray& r,
+    float* distanceOut
+  ) {
+    const Vec3xN<W> origin(r.origin);
+    const Vec3xN<W> direction(r.direction);
+    const float lengthSquared = r.direction.squaredNorm();
+
+    float closestDist[W];
+    int32_t closest[W];
+    for (int j = 0; j < W; ++j) {
+      closestDist[j] = math::VERY_BIG;
+      closest[j] = 0;
+    }
+
+    int32_t first = 0;
+    for (const LinearTime::SpherePacket& p : packets) {
+      for (int start = 0; start < p.size; start += W) {
+        for (int j = 0; j < W; ++j) {
+          float diffX = origin.x[j] - p.origins.x[start + j];
+          float diffY = origin.y[j] - p.origins.y[start + j];
+          float diffZ = origin.z[j] - p.origins.z[start + j];
+          float b = direction.x[j] * diffX + direction.y[j] * diffY
+            + direction.z[j] * diffZ;
+          float c = diffX * diffX + diffY * diffY + diffZ * diffZ
+            - p.radiiSquared[start + j];
+          float discriminant = b * b - lengthSquared * c;
+          int32_t hit = -int32_t(discriminant > 0.0f);
+          float root = math::fast::sqrt(
+            math::fast::select(hit, discriminant, 0.0f)
+          );
+          float resNeg = -b - root;
+          float resPos = -b + root;
+
+          // Take the closer positive root, like geoms::Sphere.
+          float dist = math::fast::select(
+            -int32_t(math::isPositive(resPos)),
+            resPos,
+            math::VERY_BIG
+          );
+          dist = math::fast::select(
+            -int32_t(math::isPositive(resNeg)),
+            resNeg,
+            dist
+          );
+          dist = math::fast::select(hit, dist, math::VERY_BIG);
+
+          int32_t closer = -int32_t(dist < closestDist[j]);
+          closestDist[j] = math::fast::select(closer, dist, closestDist[j]);
+          closest[j] = ((first + start + j) & closer)
+            | (closest[j] & ~closer);
+        }
+      }
+      first += LinearTime::PACKET_SIZE;
+    }
+
+    size_t best = 0;
+    float bestDist = math::VERY_BIG;
+    for (int j = 0; j < W; ++j) {
+      if (closestDist[j] < bestDist) {
+        best = size_t(closest[j]);
+        bestDist = closestDist[j];
+      }
+    }
+
+    *distanceOut = bestDist;
+    return best;
+  }
+
+  size_t sweepSpheresGeneric(
+    const LinearTime::SpherePackets& p,
+    const Ray& r,
+    float* distanceOut
+  ) {
+    return sweepSpheres<4>(p, r, distanceOut);
+  }
+
+  CPU_TARGET_AVX2 size_t sweepSpheresAvx2(
+    const LinearTime::SpherePackets& p,
+    const Ray& r,
+    float* distanceOut
+  ) {
+    return sweepSpheres<8>(p, r, distanceOut);
+  }
+
+  CPU_TARGET_AVX512 size_t sweepSpheresAvx512(
+    const LinearTime::SpherePackets& p,
+    const Ray& r,
+    float* distanceOut
+  ) {
+    return sweepSpheres<16>(p, r, distanceOut);
+  }
+
+}
+
+LinearTime::LinearTime(const std::vector<const Geom*>& o)
+  : objs(), sphereGeoms(), spheres(),
+    closestSphere(cpu::select(
+      &sweepSpheresGeneric,
+      &sweepSpheresAvx2,
+      &sweepSpheresAvx512
+    )) {
+  SpherePacket p;
+  int lane = 0;
+  for (const Geom* g : o) {
+    if (!g->isSpherical()) {
+      objs.push_back(g);
+      continue;
+    }
+
+    if (lane == 0) {
+      p.radiiSquared = Vec3x16::Lanes::Constant(-math::VERY_BIG);
+    }
+
+    BSphere bounds = g->boundSphere();
+    sphereGeoms.push_back(g);
+    p.origins.set(lane, bounds.origin);
+    p.radiiSquared[lane] = bounds.radius * bounds.radius;
+    p.size = ++lane;
+    if (lane == PACKET_SIZE) {
+      spheres.push_back(p);
+      lane = 0;
+    }
+  }
+
+  if (lane != 0) {
+    spheres.push_back(p);
+  }
+}
 
 const Geom* LinearTime::intersect(
   const Ray& r,
@@ -19,6 +161,29 @@ const Geom* LinearTime::intersect(
     }
   }
 
+  float dist = math::VERY_BIG;
+  size_t closest = sphereGeoms.empty()
+    ? 0
+    : closestSphere(spheres, r, &dist);
+  if (dist < isect.distance) {
+    // The sphere's own test gives the exact intersection. Should rounding
+    // make it disagree, test each sphere on its own.
+    Intersection cur;
+    if (sphereGeoms[closest]->intersect(r, &cur)) {
+      if (cur.distance < isect.distance) {
+        isect = cur;
+        isectGeom = sphereGeoms[closest];
+      }
+    } else {
+      for (const Geom* g : sphereGeoms) {
+        if (g->intersect(r, &cur) && cur.distance < isect.distance) {
+          isect = cur;
+          isectGeom = g;
+        }
+      }
+    }
+  }
+
   if (isectGeom) {
     *isectOut = isect;
     return isectGeom;
@@ -28,6 +193,22 @@ const Geom* LinearTime::intersect(
 }
 
 bool LinearTime::intersectShadow(const Ray& r, float maxDist) const {
+  float dist = math::VERY_BIG;
+  size_t closest = sphereGeoms.empty()
+    ? 0
+    : closestSphere(spheres, r, &dist);
+  if (math::isPositive(maxDist - dist)) {
+    if (sphereGeoms[closest]->intersectShadow(r, maxDist)) {
+      return true;
+    }
+
+    for (const Geom* g : sphereGeoms) {
+      if (g->intersectShadow(r, maxDist)) {
+        return true;
+      }
+    }
+  }
+
   for (const Geom* g : objs) {
     if (g->intersectShadow(r, maxDist)) {
       return true;
@@ -1,14 +1,65 @@
 #pragma once
+#include <cstddef>
+#include <vector>
 #include "accelerator.h"
+#include "vec3xn.h"
 
 class Geom;
 
 /**
  * A linear-time (unaccelerated) data structure for looking up ray-object
- * intersections.
+ * intersections. Objects that are exactly spheres are kept in packets of
+ * sixteen, which a ray sweeps through a bundle at a time, as wide as the
+ * CPU's vectors; only the closest sphere hit gets the full (virtual)
+ * intersection test.
  */
 class LinearTime : public Accelerator {
+public:
+  /** The number of spheres in each packet; the widest bundle of a sweep. */
+  static constexpr int PACKET_SIZE = 16;
+
+  /** Up to LinearTime::PACKET_SIZE spherical objects. */
+  struct SpherePacket {
+    Vec3x16 origins; /**< The centers of the spheres. */
+    /** The squared radii of the spheres, or -math::VERY_BIG if unused. */
+    Vec3x16::Lanes radiiSquared;
+    /**
+     * The number of spheres in the packet. A sweep may test the unused
+     * lanes up to the end of its last bundle, which no ray hits.
+     */
+    int size;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  };
+
+  /** The packets of all of the spherical objects, in order. */
+  typedef std::vector<SpherePacket, Eigen::aligned_allocator<SpherePacket>>
+    SpherePackets;
+
+  /**
+   * Finds the closest sphere that a ray hits, the same way as
+   * geoms::Sphere::intersect. Compiled once for each instruction set.
+   *
+   * @param p                the packets to test
+   * @param r                the ray
+   * @param distanceOut [out] the distance to the closest sphere, or
+   *                         math::VERY_BIG if the ray misses them all
+   * @returns                the index of the closest sphere
+   */
+  typedef size_t (*SphereKernel)(
+    const SpherePackets& p,
+    const Ray& r,
+    float* distanceOut
+  );
+
+private:
+  /** The objects that are not spheres, tested one at a time. */
   std::vector<const Geom*> objs;
+  /** The objects that are spheres, in the order of LinearTime::spheres. */
+  std::vector<const Geom*> sphereGeoms;
+  SpherePackets spheres; /**< The bounds of the spherical objects. */
+  /** The sphere kernel for the instruction set of this CPU. */
+  SphereKernel closestSphere;
 
 public:
   LinearTime(const std::vector<const Geom*>& o);
@@ -1,37 +1,77 @@
 #include "material.h"
+#include "reflectance.h"
+
+namespace {
+
+  /**
+   * Continues a path in a sampled direction; see Material::scatter.
+   *
+   * @param incoming      the ray that struck the surface
+   * @param isect         the intersection on the surface
+   * @param outgoingWorld the sampled direction, in world space
+   * @param bsdf          the BSDF in the sampled direction
+   * @param pdf           the probability of the sampled direction
+   * @param pdfOut  [out] the probability of the sampled direction; may be
+   *                      null
+   */
+  LightRay continuePath(
+    const LightRay& incoming,
+    const Intersection& isect,
+    const Vec& outgoingWorld,
+    const Vec& bsdf,
+    float pdf,
+    float* pdfOut
+  ) {
+    if (pdfOut) {
+      *pdfOut = pdf;
+    }
+
+    Vec scale;
+    if (pdf > 0.0f) {
+      scale = bsdf * fabsf(isect.normal.dot(outgoingWorld)) / pdf;
+    } else {
+      scale = Vec(0, 0, 0);
+    }
+
+    return LightRay(
+      isect.position + outgoingWorld * math::VERY_SMALL,
+      outgoingWorld,
+      incoming.color.cwiseProduct(scale)
+    );
+  }
+
+}
 
 Material::~Material() {}
 
 LightRay Material::scatter(
   Randomness& rng,
   const LightRay& incoming,
-  const Intersection& isect
+  const Intersection& isect,
+  float* pdfOut
 ) const {
   Vec outgoingWorld;
   Vec bsdf;
   float pdf;
   sampleWorld(isect, rng, -incoming.direction, &outgoingWorld, &bsdf, &pdf);
+  return continuePath(incoming, isect, outgoingWorld, bsdf, pdf, pdfOut);
+}
 
-  Vec scale;
-  if (pdf > 0.0f) {
-    scale = bsdf * fabsf(isect.normal.dot(outgoingWorld)) / pdf;
-  } else {
-    scale = Vec(0, 0, 0);
-  }
-
-  return LightRay(
-    isect.position + outgoingWorld * math::VERY_SMALL,
-    outgoingWorld,
-    incoming.color.cwiseProduct(scale)
-  );
+LightRay Material::scatter(
+  Randomness& rng,
+  const LightRay& incoming,
+  const ShadingContext& ctx,
+  float* pdfOut
+) const {
+  Vec outgoingWorld;
+  Vec bsdf;
+  float pdf;
+  sampleWorld(ctx, rng, &outgoingWorld, &bsdf, &pdf);
+  return continuePath(incoming, ctx.isect, outgoingWorld, bsdf, pdf, pdfOut);
 }
 
 float Material::evalPDFLocal(const Vec& incoming, const Vec& outgoing) const {
-  if (!math::localSameHemisphere(incoming, outgoing)) {
-    return 0.0f;
-  }
-
-  return math::cosineSampleHemispherePDF(outgoing);
+  return reflectance::lambertPDF(incoming.z(), outgoing.z());
 }
 
 void Material::evalLocal(
@@ -73,6 +113,25 @@ void Material::evalWorld(
   evalLocal(incomingLocal, outgoingLocal, bsdfOut, pdfOut);
 }
 
+void Material::evalWorld(
+  const ShadingContext& ctx,
+  const Vec& outgoing,
+  Vec* bsdfOut,
+  float* pdfOut
+) const {
+  if (ctx.lambertian) {
+    // Only the side of the surface matters, which needs no local frame.
+    float cosIncoming = ctx.incomingLocal.z();
+    float cosOutgoing = outgoing.dot(ctx.isect.normal);
+    *bsdfOut = reflectance::lambert(ctx.lambertBsdf, cosIncoming, cosOutgoing);
+    *pdfOut = reflectance::lambertPDF(cosIncoming, cosOutgoing);
+    return;
+  }
+
+  // BSDF and PDF computation expects rays to be in local-space.
+  evalLocal(ctx.incomingLocal, ctx.toLocal(outgoing), bsdfOut, pdfOut);
+}
+
 void Material::sampleLocal(
   Randomness& rng,
   const Vec& incoming,
@@ -114,14 +173,42 @@ void Material::sampleWorld(
   sampleLocal(rng, incomingLocal, &outgoingLocal, &tempBsdf, &tempPdf);
 
   // Rendering expects outgoing ray to be in world-space.
-  Vec outgoingWorld = math::localToWorld(
+  *outgoingOut = math::localToWorld(
     outgoingLocal,
     tangent,
     binormal,
     isect.normal
   );
+  *bsdfOut = tempBsdf;
+  *pdfOut = tempPdf;
+}
+
+void Material::sampleWorld(
+  const ShadingContext& ctx,
+  Randomness& rng,
+  Vec* outgoingOut,
+  Vec* bsdfOut,
+  float* pdfOut
+) const {
+  // Sample BSDF for direction, color, and probability.
+  Vec outgoingLocal;
+  Vec tempBsdf;
+  float tempPdf;
+  if (ctx.lambertian) {
+    outgoingLocal =
+      math::cosineSampleHemisphere(rng, ctx.incomingLocal.z() < 0.0f);
+    tempBsdf = ctx.lambertBsdf;
+    tempPdf = math::cosineSampleHemispherePDF(outgoingLocal);
+  } else {
+    sampleLocal(rng, ctx.incomingLocal, &outgoingLocal, &tempBsdf, &tempPdf);
+  }
 
-  *outgoingOut = outgoingWorld;
+  // Rendering expects outgoing ray to be in world-space.
+  *outgoingOut = ctx.toWorld(outgoingLocal);
   *bsdfOut = tempBsdf;
   *pdfOut = tempPdf;
 }
+
+bool Material::isLambertian() const {
+  return false;
+}
@@ -1,6 +1,25 @@
 #pragma once
 #include "core.h"
 #include "node.h"
+#include "shading_context.h"
+
+/**
+ * The parameters of a material, flattened into the same plain block for
+ * every kind of material so that they can be stored in a MaterialTable.
+ */
+struct MaterialParams {
+  /** The kinds of materials. */
+  enum class Type {
+    LAMBERT, /**< See materials::Lambert. */
+    PHONG, /**< See materials::Phong. */
+    DIELECTRIC /**< See materials::Dielectric. */
+  };
+
+  Type type; /**< The kind of material. */
+  Vec color; /**< The albedo or color of the material. */
+  float exponent; /**< The Phong exponent, for Phong materials. */
+  float ior; /**< The index of refraction, for dielectric materials. */
+};
 
 /**
  * A material that specifies how light scatters on geometry using a BSDF.
@@ -37,16 +56,34 @@ public:
    * Determines whether another ray should be cast as a consequence of a
    * lightray hitting a surface.
    *
-   * @param incoming the incoming ray that struck the surface
-   * @param isect    the intersection information for the incoming ray
-   * @param rng      the per-thread RNG in use
-   * @returns        a lightray to cast as a consequence; a zero-length ray will
-   *                 terminate the path
+   * @param rng          the per-thread RNG in use
+   * @param incoming     the incoming ray that struck the surface
+   * @param isect        the intersection information for the incoming ray
+   * @param pdfOut [out] the probability with which the outgoing direction was
+   *                     sampled; may be null if the probability is not needed
+   * @returns            a lightray to cast as a consequence; a zero-length ray
+   *                     will terminate the path
+   *
+   * This and the other overloads that take an intersection build only the
+   * local frame, not a ShadingContext, so that one-off bounces (e.g. off
+   * specular surfaces) make no virtual calls beyond the BSDF's own.
+   */
+  LightRay scatter(
+    Randomness& rng,
+    const LightRay& incoming,
+    const Intersection& isect,
+    float* pdfOut = nullptr
+  ) const;
+
+  /**
+   * Same as Material::scatter, but reuses the shading frame of the given
+   * context, whose material must be this one.
    */
   LightRay scatter(
     Randomness& rng,
     const LightRay& incoming,
-    const Intersection& isect
+    const ShadingContext& ctx,
+    float* pdfOut = nullptr
   ) const;
 
   /**
@@ -89,6 +126,18 @@ public:
     float* pdfOut
   ) const;
 
+  /**
+   * Same as Material::sampleWorld, but reuses the shading frame and incoming
+   * direction of the given context, whose material must be this one.
+   */
+  void sampleWorld(
+    const ShadingContext& ctx,
+    Randomness& rng,
+    Vec* outgoingOut,
+    Vec* bsdfOut,
+    float* pdfOut
+  ) const;
+
   /**
    * Evaluates the BSDF and PDF for an incoming and an outgoing direction in the
    * local (normal) coordinate system.
@@ -117,9 +166,42 @@ public:
     float* pdfOut
   ) const;
 
+  /**
+   * Same as Material::evalWorld, but reuses the shading frame and incoming
+   * direction of the given context, whose material must be this one.
+   * Lambertian materials are evaluated without any virtual calls.
+   */
+  void evalWorld(
+    const ShadingContext& ctx,
+    const Vec& outgoing,
+    Vec* bsdfOut,
+    float* pdfOut
+  ) const;
+
   /**
    * Returns true if direct illumination should be estimated for surfaces with
    * this material. Otherwise, only path tracing will be used.
    */
   virtual bool shouldDirectIlluminate() const = 0;
+
+  /**
+   * Returns true if the BSDF is Material::baseColor over pi for any two
+   * directions on the same side of the surface (and zero otherwise), and
+   * directions are sampled as by the default Material::sampleLocal. Shading
+   * contexts then evaluate and sample the material in closed form. The
+   * default implementation returns false.
+   */
+  virtual bool isLambertian() const;
+
+  /**
+   * Returns the overall color of this material, e.g. for use as the albedo
+   * guiding the denoiser.
+   */
+  virtual Vec baseColor() const = 0;
+
+  /**
+   * Returns the parameters of this material, for flattening into a
+   * MaterialTable.
+   */
+  virtual MaterialParams params() const = 0;
 };
@@ -0,0 +1,152 @@
+#include "material_table.h"
+#include "cpu_dispatch.h"
+#include "reflectance.h"
+
+using std::min;
+using std::max;
+
+namespace {
+
+  /** Evaluates a Phong material; see MaterialTable::evalBatch. */
+  CPU_KERNEL void evalPhong(
+    const MaterialTable::Entry& entry,
+    const Vec& incoming,
+    size_t n,
+    const Vec* outgoing,
+    Vec* bsdfOut,
+    float* pdfOut
+  ) {
+    // See materials::Phong. The powers go through the wide fast-math
+    // variant a full set of lanes at a time, padding the last set.
+    for (size_t i = 0; i < n; i += math::fast::LANES) {
+      size_t lanes = min(math::fast::LANES, n - i);
+      float cosAlpha[math::fast::LANES];
+      float cosAlphaPow[math::fast::LANES];
+      for (size_t j = 0; j < math::fast::LANES; ++j) {
+        cosAlpha[j] = j < lanes
+          ? reflectance::phongCosine(incoming, outgoing[i + j])
+          : 0.0f;
+      }
+
+      math::fast::powN<math::fast::LANES>(
+        cosAlpha,
+        entry.exponent,
+        cosAlphaPow
+      );
+      for (size_t j = 0; j < lanes; ++j) {
+        bsdfOut[i + j] = entry.bsdfScale * cosAlphaPow[j];
+        pdfOut[i + j] = entry.pdfScale * cosAlphaPow[j];
+      }
+    }
+  }
+
+  void evalPhongGeneric(
+    const MaterialTable::Entry& entry,
+    const Vec& incoming,
+    size_t n,
+    const Vec* outgoing,
+    Vec* bsdfOut,
+    float* pdfOut
+  ) {
+    evalPhong(entry, incoming, n, outgoing, bsdfOut, pdfOut);
+  }
+
+  CPU_TARGET_AVX2 void evalPhongAvx2(
+    const MaterialTable::Entry& entry,
+    const Vec& incoming,
+    size_t n,
+    const Vec* outgoing,
+    Vec* bsdfOut,
+    float* pdfOut
+  ) {
+    evalPhong(entry, incoming, n, outgoing, bsdfOut, pdfOut);
+  }
+
+  CPU_TARGET_AVX512 void evalPhongAvx512(
+    const MaterialTable::Entry& entry,
+    const Vec& incoming,
+    size_t n,
+    const Vec* outgoing,
+    Vec* bsdfOut,
+    float* pdfOut
+  ) {
+    evalPhong(entry, incoming, n, outgoing, bsdfOut, pdfOut);
+  }
+
+}
+
+MaterialTable::MaterialTable()
+  : entries(), indices(),
+    phongKernel(
+      cpu::select(&evalPhongGeneric, &evalPhongAvx2, &evalPhongAvx512)
+    ) {}
+
+int MaterialTable::add(const Material* mat) {
+  auto it = indices.find(mat);
+  if (it != indices.end()) {
+    return it->second;
+  }
+
+  // Cache the same terms that the material classes do.
+  MaterialParams params = mat->params();
+  Entry entry;
+  entry.type = params.type;
+  entry.exponent = params.exponent;
+  switch (params.type) {
+    case MaterialParams::Type::LAMBERT:
+      entry.bsdfScale = reflectance::lambertScale(params.color);
+      entry.pdfScale = 0.0f;
+      break;
+    case MaterialParams::Type::PHONG:
+      entry.bsdfScale = reflectance::phongScale(params.color, params.exponent);
+      entry.pdfScale = reflectance::phongPDFScale(params.exponent);
+      break;
+    case MaterialParams::Type::DIELECTRIC:
+      entry.bsdfScale = Vec(0, 0, 0);
+      entry.pdfScale = 0.0f;
+      break;
+  }
+
+  int idx = int(entries.size());
+  entries.push_back(entry);
+  indices[mat] = idx;
+  return idx;
+}
+
+int MaterialTable::indexOf(const Material* mat) const {
+  auto it = indices.find(mat);
+  return it == indices.end() ? -1 : it->second;
+}
+
+void MaterialTable::evalBatch(
+  int idx,
+  const Vec& incoming,
+  size_t n,
+  const Vec* outgoing,
+  Vec* bsdfOut,
+  float* pdfOut
+) const {
+  const Entry& entry = entries[size_t(idx)];
+  switch (entry.type) {
+    case MaterialParams::Type::LAMBERT:
+      for (size_t i = 0; i < n; ++i) {
+        bsdfOut[i] = reflectance::lambert(
+          entry.bsdfScale,
+          incoming.z(),
+          outgoing[i].z()
+        );
+        pdfOut[i] = reflectance::lambertPDF(incoming.z(), outgoing[i].z());
+      }
+      break;
+    case MaterialParams::Type::PHONG:
+      phongKernel(entry, incoming, n, outgoing, bsdfOut, pdfOut);
+      break;
+    case MaterialParams::Type::DIELECTRIC:
+      // Probabilistically, no pair of directions matches exactly.
+      for (size_t i = 0; i < n; ++i) {
+        bsdfOut[i] = Vec(0, 0, 0);
+        pdfOut[i] = 0.0f;
+      }
+      break;
+  }
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+#include "core.h"
+#include "material.h"
+
+/**
+ * A flat array of the materials in a scene, each stored as a plain block of
+ * parameters with a type tag, for evaluating a material's BSDF for many
+ * directions at once. A batch switches on the material's type once and then
+ * runs a tight loop over the directions, without virtual calls or pointer
+ * chasing, which the compiler is free to vectorize.
+ *
+ * The material classes stay the parsing front-end; the table is built from
+ * their parameters.
+ */
+class MaterialTable {
+public:
+  /** A material, with the terms that its BSDF needs precomputed. */
+  struct Entry {
+    MaterialParams::Type type; /**< The kind of material. */
+    Vec bsdfScale; /**< The BSDF (Lambert) or its scale (Phong). */
+    float pdfScale; /**< The scale of the PDF (Phong). */
+    float exponent; /**< The Phong exponent (Phong). */
+  };
+
+  /**
+   * Evaluates a Phong material for many directions; see evalBatch. Compiled
+   * once for each instruction set.
+   */
+  typedef void (*PhongKernel)(
+    const Entry& entry,
+    const Vec& incoming,
+    size_t n,
+    const Vec* outgoing,
+    Vec* bsdfOut,
+    float* pdfOut
+  );
+
+private:
+  std::vector<Entry> entries; /**< The materials. */
+  /** Maps each material to its index in MaterialTable::entries. */
+  std::unordered_map<const Material*, int> indices;
+  /** The Phong kernel for the instruction set of this CPU. */
+  PhongKernel phongKernel;
+
+public:
+  /** The most directions that a single batch should hold. */
+  static constexpr size_t BATCH_SIZE = 64;
+
+  /**
+   * Constructs an empty table.
+   */
+  MaterialTable();
+
+  /**
+   * Adds the given material to the table, unless it is already there.
+   *
+   * @param mat the material to add
+   * @returns   the index of the material in the table
+   */
+  int add(const Material* mat);
+
+  /**
+   * Returns the index of the given material in the table, or -1 if it was
+   * never added.
+   */
+  int indexOf(const Material* mat) const;
+
+  /** Returns the material at the given index. */
+  inline const Entry& operator[](int idx) const {
+    return entries[size_t(idx)];
+  }
+
+  /**
+   * Evaluates the BSDF and PDF of a material for one incoming direction and
+   * many outgoing directions, all in the local (normal) coordinate system.
+   * Same as Material::evalLocal for each direction.
+   *
+   * @param idx          the index of the material
+   * @param incoming     the incoming direction
+   * @param n            the number of outgoing directions
+   * @param outgoing     the outgoing directions
+   * @param bsdfOut [out] the value of the BSDF for each outgoing direction
+   * @param pdfOut  [out] the value of the PDF for each outgoing direction
+   */
+  void evalBatch(
+    int idx,
+    const Vec& incoming,
+    size_t n,
+    const Vec* outgoing,
+    Vec* bsdfOut,
+    float* pdfOut
+  ) const;
+};
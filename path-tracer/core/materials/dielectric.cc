@@ -120,3 +120,16 @@ void materials::Dielectric::sampleLocal(
 bool materials::Dielectric::shouldDirectIlluminate() const {
   return false;
 }
+
+Vec materials::Dielectric::baseColor() const {
+  return color;
+}
+
+MaterialParams materials::Dielectric::params() const {
+  return MaterialParams{
+    MaterialParams::Type::DIELECTRIC,
+    color,
+    0.0f,
+    etaExiting * IOR_VACUUM
+  };
+}
@@ -58,6 +58,10 @@ namespace materials {
     ) const override;
 
     virtual bool shouldDirectIlluminate() const override;
+
+    virtual Vec baseColor() const override;
+
+    virtual MaterialParams params() const override;
   };
 
 }
@@ -1,4 +1,5 @@
 #include "lambert.h"
+#include "../reflectance.h"
 
 materials::Lambert::Lambert(const Vec& a) : albedo(a) {}
 
@@ -8,13 +9,25 @@ Vec materials::Lambert::evalBSDFLocal(
   const Vec& incoming,
   const Vec& outgoing
 ) const {
-  if (!math::localSameHemisphere(incoming, outgoing)) {
-    return Vec(0, 0, 0);
-  }
-
-  return albedo * math::INV_PI;
+  return reflectance::lambert(
+    reflectance::lambertScale(albedo),
+    incoming.z(),
+    outgoing.z()
+  );
 }
 
 bool materials::Lambert::shouldDirectIlluminate() const {
   return true;
 }
+
+bool materials::Lambert::isLambertian() const {
+  return true;
+}
+
+Vec materials::Lambert::baseColor() const {
+  return albedo;
+}
+
+MaterialParams materials::Lambert::params() const {
+  return MaterialParams{MaterialParams::Type::LAMBERT, albedo, 0.0f, 1.0f};
+}
@@ -23,6 +23,12 @@ namespace materials {
     Lambert(const Node& n);
 
     virtual bool shouldDirectIlluminate() const override;
+
+    virtual bool isLambertian() const override;
+
+    virtual Vec baseColor() const override;
+
+    virtual MaterialParams params() const override;
   };
 
 }
@@ -1,60 +1,38 @@
 #include "phong.h"
+#include "../reflectance.h"
 
 using std::min;
 using std::max;
 
 materials::Phong::Phong(float e, const Vec& c)
-  : scaleBRDF(c * (e + 2.0f) / math::TWO_PI),
-    scaleProb((e + 1.0f) / math::TWO_PI),
+  : scaleBRDF(reflectance::phongScale(c, e)),
+    scaleProb(reflectance::phongPDFScale(e)),
     invExponent(1.0f / (e + 1.0f)),
     color(c), exponent(e) {}
 
 materials::Phong::Phong(const Node& n)
   : Phong(n.getFloat("exponent"), n.getVec("color")) {}
 
-inline Vec materials::Phong::evalBSDFInternal(
-  const Vec& perfectReflect,
-  const Vec& outgoing
-) const {
-  float cosAlpha = max(0.0f, outgoing.dot(perfectReflect));
-  float cosAlphaPow = std::pow(cosAlpha, exponent);
-
-  return scaleBRDF * cosAlphaPow;
-}
-
-inline float materials::Phong::evalPDFInternal(
-  const Vec& perfectReflect,
+inline float materials::Phong::lobe(
+  const Vec& incoming,
   const Vec& outgoing
 ) const {
-  float cosAlpha = max(0.0f, outgoing.dot(perfectReflect));
-  float cosAlphaPow = std::pow(cosAlpha, exponent);
-
-  return scaleProb * cosAlphaPow;
+  float cosAlpha = reflectance::phongCosine(incoming, outgoing);
+  return math::fast::pow(cosAlpha, exponent);
 }
 
 Vec materials::Phong::evalBSDFLocal(
   const Vec& incoming,
   const Vec& outgoing
 ) const {
-  // See Lafortune & Willems <http://www.graphics.cornell.edu/~eric/Phong.html>.
-  if (!math::localSameHemisphere(incoming, outgoing)) {
-    return Vec(0, 0, 0);
-  }
-
-  Vec perfectReflect(-incoming.x(), -incoming.y(), incoming.z());
-  return evalBSDFInternal(perfectReflect, outgoing);
+  return scaleBRDF * lobe(incoming, outgoing);
 }
 
 float materials::Phong::evalPDFLocal(
   const Vec& incoming,
   const Vec& outgoing
 ) const {
-  if (!math::localSameHemisphere(incoming, outgoing)) {
-    return 0.0f;
-  }
-
-  Vec perfectReflect(-incoming.x(), -incoming.y(), incoming.z());
-  return evalPDFInternal(perfectReflect, outgoing);
+  return scaleProb * lobe(incoming, outgoing);
 }
 
 void materials::Phong::sampleLocal(
@@ -66,7 +44,7 @@ void materials::Phong::sampleLocal(
 ) const {
   // See Lafortune & Willems <http://www.graphics.cornell.edu/~eric/Phong.html>
   // for a derivation of the sampling procedure and PDF.
-  Vec perfectReflect(-incoming.x(), -incoming.y(), incoming.z());
+  Vec perfectReflect = reflectance::phongReflect(incoming);
   Vec reflectTangent;
   Vec reflectBinormal;
 
@@ -90,10 +68,13 @@ void materials::Phong::sampleLocal(
    *
    * @endcode
    */
-  float cosTheta = std::pow(rng.nextUnitFloat(), invExponent);
+  float cosTheta = math::fast::pow(rng.nextUnitFloat(), invExponent);
   float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
   float phi = math::TWO_PI * rng.nextUnitFloat();
-  Vec local(cosf(phi) * sinTheta, sinf(phi) * sinTheta, cosTheta);
+  float sinPhi;
+  float cosPhi;
+  math::fast::sincos(phi, &sinPhi, &cosPhi);
+  Vec local(cosPhi * sinTheta, sinPhi * sinTheta, cosTheta);
 
   // Here, "local" being the space of the perfect reflection vector and
   // "world" being the space of the normal.
@@ -103,10 +84,19 @@ void materials::Phong::sampleLocal(
     reflectBinormal,
     perfectReflect
   );
-  *bsdfOut = evalBSDFInternal(perfectReflect, *outgoingOut);
-  *pdfOut = evalPDFInternal(perfectReflect, *outgoingOut);
+  float cosAlphaPow = lobe(incoming, *outgoingOut);
+  *bsdfOut = scaleBRDF * cosAlphaPow;
+  *pdfOut = scaleProb * cosAlphaPow;
 }
 
 bool materials::Phong::shouldDirectIlluminate() const {
   return true;
 }
+
+Vec materials::Phong::baseColor() const {
+  return color;
+}
+
+MaterialParams materials::Phong::params() const {
+  return MaterialParams{MaterialParams::Type::PHONG, color, exponent, 1.0f};
+}
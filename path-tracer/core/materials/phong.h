@@ -12,15 +12,11 @@ namespace materials {
     const float scaleProb; /**< Cached scaling term in the PDF. */
     const float invExponent; /**< Cached inverse exponent term. */
 
-    inline Vec evalBSDFInternal(
-      const Vec& perfectReflect,
-      const Vec& outgoing
-    ) const;
-
-    inline float evalPDFInternal(
-      const Vec& perfectReflect,
-      const Vec& outgoing
-    ) const;
+    /**
+     * Returns the Phong lobe, which the BSDF and PDF scale; see
+     * reflectance::phongCosine.
+     */
+    inline float lobe(const Vec& incoming, const Vec& outgoing) const;
 
   protected:
     virtual Vec evalBSDFLocal(
@@ -63,6 +59,10 @@ namespace materials {
     ) const override;
 
     virtual bool shouldDirectIlluminate() const override;
+
+    virtual Vec baseColor() const override;
+
+    virtual MaterialParams params() const override;
   };
 
 }
@@ -7,6 +7,7 @@
 #include <vector>
 #include <Eigen/Dense>
 #include <Eigen/Geometry>
+#include "fast_math.h"
 #include "randomness.h"
 
 using std::min;
@@ -222,6 +223,13 @@ namespace math {
     return v.x() == 0.0f && v.y() == 0.0f && v.z() == 0.0f;
   }
 
+  /**
+   * Returns the perceived luminance of a color, assuming it is RGB.
+   */
+  inline float luminance(const Vec& c) {
+    return 0.21f * c.x() + 0.71f * c.y() + 0.08f * c.z();
+  }
+
   /**
    * Calculates the base-2 logarithm of a number.
    */
@@ -332,12 +340,20 @@ namespace math {
     return clamp(v.y() / sinT, -1.0f, 1.0f);
   }
 
+  /**
+   * Determines if two directions are on the same side of a surface, given
+   * the cosines of their angles with its normal.
+   */
+  inline bool sameHemisphere(float cosU, float cosV) {
+    return cosU * cosV >= 0.0f;
+  }
+
   /**
    * Determines if two vectors in the same local coordinate space are in the 
    * same hemisphere.
    */
   inline bool localSameHemisphere(const Vec& u, const Vec& v) {
-    return u.z() * v.z() >= 0.0f;
+    return sameHemisphere(u.z(), v.z());
   }
 
   /**
@@ -389,8 +405,11 @@ namespace math {
       }
     }
     theta *= math::PI_4;
-    *dx = r * cosf(theta);
-    *dy = r * sinf(theta);
+    float sinTheta;
+    float cosTheta;
+    fast::sincos(theta, &sinTheta, &cosTheta);
+    *dx = r * cosTheta;
+    *dy = r * sinTheta;
   }
 
   /**
@@ -461,7 +480,7 @@ namespace math {
    * @returns         the probability that the angle was sampled
    */
   inline float uniformSampleConePDF(float halfAngle) {
-    const float solidAngle = math::TWO_PI * (1.0f - cosf(halfAngle));
+    const float solidAngle = math::TWO_PI * (1.0f - fast::cos(halfAngle));
     return 1.0f / solidAngle;
   }
 
@@ -476,7 +495,7 @@ namespace math {
    * @returns         the probability that the angle was sampled
    */
   inline float uniformSampleConePDF(float halfAngle, const Vec& direction) {
-    const float cosHalfAngle = cosf(halfAngle);
+    const float cosHalfAngle = fast::cos(halfAngle);
     const float solidAngle = math::TWO_PI * (1.0f - cosHalfAngle);
     if (cosTheta(direction) > cosHalfAngle) {
       // Within the sampling cone.
@@ -511,12 +530,15 @@ namespace math {
    *                  the positive z-axis
    */
   inline Vec uniformSampleCone(Randomness& rng, float halfAngle) {
-    float h = cosf(halfAngle);
+    float h = fast::cos(halfAngle);
     float z = rng.nextFloat(h, 1.0f);
     float t = rng.nextFloat(float(PI * 2.0));
     float r = sqrtf(1.0f - (z * z));
-    float x = r * cosf(t);
-    float y = r * sinf(t);
+    float sinT;
+    float cosT;
+    fast::sincos(t, &sinT, &cosT);
+    float x = r * cosT;
+    float y = r * sinT;
 
     return Vec(x, y, z);
   }
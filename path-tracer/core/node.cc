@@ -21,6 +21,14 @@ std::string Node::getString(std::string key) const {
   return *result;
 }
 
+std::string Node::getString(std::string key, std::string defaultValue) const {
+  if (attributes.count(key) == 0) {
+    return defaultValue;
+  }
+
+  return getString(key);
+}
+
 int Node::getInt(std::string key) const {
   auto result = attributes.get_optional<int>(key);
 
@@ -33,6 +41,14 @@ int Node::getInt(std::string key) const {
   return *result;
 }
 
+int Node::getInt(std::string key, int defaultValue) const {
+  if (attributes.count(key) == 0) {
+    return defaultValue;
+  }
+
+  return getInt(key);
+}
+
 bool Node::getBool(std::string key) const {
   auto result = attributes.get_optional<bool>(key);
 
@@ -45,6 +61,14 @@ bool Node::getBool(std::string key) const {
   return *result;
 }
 
+bool Node::getBool(std::string key, bool defaultValue) const {
+  if (attributes.count(key) == 0) {
+    return defaultValue;
+  }
+
+  return getBool(key);
+}
+
 float Node::getFloat(std::string key) const {
   auto result = attributes.get_optional<float>(key);
 
@@ -86,6 +110,28 @@ const AreaLight* Node::getLight(std::string key) const {
   return *result;
 }
 
+const InfiniteLight* Node::getEnvironment(std::string key) const {
+  using NodeEnvironmentTranslator =
+    Node::NodeLookupTranslator<const InfiniteLight*>;
+  if (attributes.count(key) == 0) {
+    return nullptr;
+  }
+
+  const NodeEnvironmentTranslator t(container.environments);
+  auto result = attributes.get_optional<
+    const InfiniteLight*, NodeEnvironmentTranslator
+  >(key, t);
+
+  if (!result) {
+    const std::string itemName = attributes.get<std::string>(key);
+    const std::string msg =
+      "Cannot resolve environment reference '%1%' in property '%2%'";
+    throw std::runtime_error(str(format(msg) % itemName % key));
+  }
+
+  return *result;
+}
+
 const Material* Node::getMaterial(std::string key) const {
   using NodeMaterialTranslator = Node::NodeLookupTranslator<const Material*>;
   const NodeMaterialTranslator t(container.materials);
@@ -5,6 +5,7 @@
 #include "core.h"
 
 class AreaLight;
+class InfiniteLight;
 class Material;
 class Geom;
 class Scene;
@@ -48,16 +49,36 @@ public:
 
   /** Gets the string property at the given key. */
   std::string getString(std::string key) const;
+  /**
+   * Gets the string property at the given key, or the given default if the
+   * key is missing.
+   */
+  std::string getString(std::string key, std::string defaultValue) const;
   /** Gets the integer property at the given key. */
   int getInt(std::string key) const;
+  /**
+   * Gets the integer property at the given key, or the given default if the
+   * key is missing.
+   */
+  int getInt(std::string key, int defaultValue) const;
   /** Gets the boolean property at the given key. */
   bool getBool(std::string key) const;
+  /**
+   * Gets the boolean property at the given key, or the given default if the
+   * key is missing.
+   */
+  bool getBool(std::string key, bool defaultValue) const;
   /** Gets the float property at the given key. */
   float getFloat(std::string key) const;
   /** Gets the 3D vector property at the given key. */
   Vec getVec(std::string key) const;
   /** Gets the light pointer referenced by the given key. */
   const AreaLight* getLight(std::string key) const;
+  /**
+   * Gets the environment light pointer referenced by the given key, or null
+   * if the key is missing or empty.
+   */
+  const InfiniteLight* getEnvironment(std::string key) const;
   /** Gets the material pointer referenced by the given key. */
   const Material* getMaterial(std::string key) const;
   /** Gets the geometry pointer referenced by the given key. */
@@ -0,0 +1,73 @@
+#include "path_vertex.h"
+#include "light.h"
+#include "material.h"
+
+PathVertex::PathVertex()
+  : type(Type::SURFACE), isect(), wo(0, 0, 0), geom(nullptr), beta(0, 0, 0),
+    delta(false), offFilm(false), pdfFwd(0.0f), pdfRev(0.0f) {}
+
+PathVertex::PathVertex(
+  Type t,
+  const Intersection& i,
+  const Geom* g,
+  const Vec& b
+) : type(t), isect(i), wo(0, 0, 0), geom(g), beta(b), delta(false),
+    offFilm(false), pdfFwd(0.0f), pdfRev(0.0f) {}
+
+float PathVertex::convertDensity(float pdf, const PathVertex& next) const {
+  Vec toNext = next.position() - position();
+  float dist2 = toNext.squaredNorm();
+  if (dist2 == 0.0f) {
+    return 0.0f;
+  }
+
+  return pdf * next.absCos(toNext / sqrtf(dist2)) / dist2;
+}
+
+Vec PathVertex::f(const PathVertex& next) const {
+  Vec toNext = (next.position() - position()).normalized();
+  Vec bsdf;
+  float pdf;
+  geom->mat->evalWorld(isect, wo, toNext, &bsdf, &pdf);
+  return bsdf;
+}
+
+float PathVertex::pdfSurface(
+  const PathVertex* prev,
+  const PathVertex& next
+) const {
+  Vec toPrev = prev ? (prev->position() - position()).normalized() : wo;
+  Vec toNext = (next.position() - position()).normalized();
+  Vec bsdf;
+  float pdf;
+  geom->mat->evalWorld(isect, toPrev, toNext, &bsdf, &pdf);
+  return convertDensity(pdf, next);
+}
+
+float PathVertex::pdfLight(const PathVertex& next) const {
+  // Light subpaths leave emitters with a cosine-weighted distribution.
+  Vec toNext = (next.position() - position()).normalized();
+  float cosTheta = isect.normal.dot(toNext);
+  if (cosTheta <= 0.0f) {
+    return 0.0f;
+  }
+
+  return convertDensity(cosTheta * math::INV_PI, next);
+}
+
+Vec PathVertex::emitted(const PathVertex& towards) const {
+  if (!geom || !geom->light) {
+    return Vec(0, 0, 0);
+  }
+
+  Vec toTowards = towards.position() - position();
+  return geom->light->emit(Ray(towards.position(), -toTowards), isect);
+}
+
+float PathVertex::absCos(const Vec& dir) const {
+  if (type == Type::CAMERA) {
+    return 1.0f;
+  }
+
+  return fabsf(isect.normal.dot(dir));
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "core.h"
+#include "geom.h"
+
+/**
+ * A vertex of a camera or light subpath, as built for bidirectional path
+ * tracing. Probabilities are stored with respect to surface area at the
+ * vertex, so that the probabilities of different ways of sampling the same
+ * path can be compared directly.
+ *
+ * See Veach's thesis, chapter 10, and Pharr & Humphreys (3rd ed.) section
+ * 16.3.
+ */
+struct PathVertex {
+  /** The kinds of vertices that can appear on a path. */
+  enum class Type {
+    CAMERA, /**< The first vertex of a camera subpath, on the lens. */
+    LIGHT, /**< The first vertex of a light subpath, on an emitter. */
+    SURFACE /**< A vertex where the path scattered off of geometry. */
+  };
+
+  Type type; /**< The kind of vertex. */
+  /**
+   * The position and normal of the vertex. For camera vertices, the normal
+   * is the viewing direction.
+   */
+  Intersection isect;
+  Vec wo; /**< The direction towards the previous vertex on the subpath. */
+  /**
+   * The geometry at the vertex (the emitter for light vertices), or null for
+   * camera vertices.
+   */
+  const Geom* geom;
+  Vec beta; /**< The subpath's throughput up to this vertex. */
+  /** Whether the vertex can't be connected to another subpath. */
+  bool delta;
+  /**
+   * For camera vertices, whether the ray leaving the vertex misses the film,
+   * so that light subpaths could not have reached the camera along it.
+   */
+  bool offFilm;
+  float pdfFwd; /**< The probability of sampling the vertex forwards. */
+  float pdfRev; /**< The probability of sampling the vertex in reverse. */
+
+  PathVertex();
+
+  /**
+   * Constructs a vertex of the given type.
+   *
+   * @param t the kind of vertex
+   * @param i the position and normal of the vertex
+   * @param g the geometry at the vertex, if any
+   * @param b the subpath's throughput up to the vertex
+   */
+  PathVertex(Type t, const Intersection& i, const Geom* g, const Vec& b);
+
+  /** Returns the position of the vertex. */
+  inline const Vec& position() const { return isect.position; }
+
+  /**
+   * Converts a probability with respect to solid angle at this vertex into a
+   * probability with respect to area at the next vertex.
+   */
+  float convertDensity(float pdf, const PathVertex& next) const;
+
+  /**
+   * Evaluates the BSDF for scattering from the previous vertex towards the
+   * given vertex. Only valid for surface vertices.
+   */
+  Vec f(const PathVertex& next) const;
+
+  /**
+   * Returns the probability, with respect to area at the next vertex, that
+   * the material would scatter from the previous vertex towards the next.
+   * Only valid for surface vertices.
+   *
+   * @param prev the previous vertex, or null to use PathVertex::wo
+   * @param next the next vertex
+   */
+  float pdfSurface(const PathVertex* prev, const PathVertex& next) const;
+
+  /**
+   * Returns the probability, with respect to area at the next vertex, that a
+   * light subpath starting at this vertex would continue towards the next.
+   * Only valid for vertices on emitters.
+   */
+  float pdfLight(const PathVertex& next) const;
+
+  /**
+   * Returns the radiance emitted from this vertex towards the given vertex.
+   * Only valid for vertices on geometry.
+   */
+  Vec emitted(const PathVertex& towards) const;
+
+  /**
+   * Returns the cosine between the vertex's normal and the given direction,
+   * or 1 if the vertex is not on a surface.
+   */
+  float absCos(const Vec& dir) const;
+};
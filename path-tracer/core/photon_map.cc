@@ -0,0 +1,52 @@
+#include "photon_map.h"
+#include <algorithm>
+
+PhotonMap::PhotonMap() : photons(), cellStarts(1, 0), radius(0.0f),
+  cellSize(1.0f) {}
+
+void PhotonMap::cellOf(
+  const Vec& p,
+  long* xOut,
+  long* yOut,
+  long* zOut
+) const {
+  *xOut = long(floorf(p.x() / cellSize));
+  *yOut = long(floorf(p.y() / cellSize));
+  *zOut = long(floorf(p.z() / cellSize));
+}
+
+size_t PhotonMap::bucketOf(long x, long y, long z) const {
+  // See Teschner et al., "Optimized Spatial Hashing for Collision Detection
+  // of Deformable Objects" (2003).
+  size_t h = (size_t(x) * 73856093u) ^ (size_t(y) * 19349663u)
+    ^ (size_t(z) * 83492791u);
+  return h % (cellStarts.size() - 1);
+}
+
+void PhotonMap::build(const std::vector<Photon>& ps, float r) {
+  radius = r;
+  cellSize = 2.0f * r;
+
+  // One bucket per photon keeps collisions between cells rare.
+  size_t numBuckets = std::max<size_t>(ps.size(), 1);
+  cellStarts.assign(numBuckets + 1, 0);
+
+  // Counting sort the photons by bucket.
+  std::vector<size_t> buckets(ps.size());
+  for (size_t i = 0; i < ps.size(); ++i) {
+    long x, y, z;
+    cellOf(ps[i].position, &x, &y, &z);
+    buckets[i] = bucketOf(x, y, z);
+    cellStarts[buckets[i] + 1]++;
+  }
+
+  for (size_t i = 1; i <= numBuckets; ++i) {
+    cellStarts[i] += cellStarts[i - 1];
+  }
+
+  photons.resize(ps.size());
+  std::vector<uint32_t> next(cellStarts.begin(), cellStarts.end() - 1);
+  for (size_t i = 0; i < ps.size(); ++i) {
+    photons[next[buckets[i]]++] = ps[i];
+  }
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "core.h"
+
+/**
+ * Stores photons in a hashed uniform grid for fast lookup of the photons
+ * near a point. The grid's cells are as wide as the lookup diameter, so a
+ * lookup only needs to visit the eight cells around the point, and photons in
+ * the same cell are stored next to each other.
+ *
+ * See Hachisuka & Jensen, "Parallel Progressive Photon Mapping on GPUs"
+ * (2010), for the hashed grid.
+ */
+class PhotonMap {
+public:
+  /** A packet of light that arrived at a surface. */
+  struct Photon {
+    Vec position; /**< Where the photon arrived. */
+    Vec direction; /**< The direction that the photon arrived from. */
+    Vec power; /**< The power carried by the photon. */
+  };
+
+private:
+  std::vector<Photon> photons; /**< The photons, grouped by cell. */
+  /**
+   * The index of the first photon in each hash bucket; bucket i holds
+   * photons cellStarts[i] through cellStarts[i + 1] - 1.
+   */
+  std::vector<uint32_t> cellStarts;
+  float radius; /**< The lookup radius. */
+  float cellSize; /**< The width of each grid cell. */
+
+  /** Returns the grid cell containing the given point. */
+  void cellOf(const Vec& p, long* xOut, long* yOut, long* zOut) const;
+
+  /** Returns the hash bucket for the given grid cell. */
+  size_t bucketOf(long x, long y, long z) const;
+
+public:
+  /**
+   * Constructs an empty photon map.
+   */
+  PhotonMap();
+
+  /** Returns the number of photons in the map. */
+  inline size_t size() const { return photons.size(); }
+
+  /** Returns the lookup radius. */
+  inline float lookupRadius() const { return radius; }
+
+  /**
+   * Replaces the contents of the map with the given photons.
+   *
+   * @param ps the photons to store
+   * @param r  the radius that lookups will use
+   */
+  void build(const std::vector<Photon>& ps, float r);
+
+  /**
+   * Calls the given function for each photon within the lookup radius of the
+   * given point.
+   *
+   * @param p     the point to look around
+   * @param visit the function to call with each photon
+   */
+  template<typename Func>
+  void lookup(const Vec& p, Func visit) const {
+    if (photons.empty()) {
+      return;
+    }
+
+    // The cells overlapping the lookup sphere form a 2x2x2 block.
+    long x0, y0, z0;
+    cellOf(p - Vec(radius, radius, radius), &x0, &y0, &z0);
+
+    float radius2 = radius * radius;
+    for (long z = z0; z <= z0 + 1; ++z) {
+      for (long y = y0; y <= y0 + 1; ++y) {
+        for (long x = x0; x <= x0 + 1; ++x) {
+          size_t bucket = bucketOf(x, y, z);
+          for (uint32_t i = cellStarts[bucket];
+               i < cellStarts[bucket + 1]; ++i) {
+            const Photon& photon = photons[i];
+            if ((photon.position - p).squaredNorm() <= radius2) {
+              visit(photon);
+            }
+          }
+        }
+      }
+    }
+  }
+};
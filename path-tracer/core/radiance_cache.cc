@@ -0,0 +1,139 @@
+#include "radiance_cache.h"
+#include <algorithm>
+
+using std::max;
+using std::min;
+
+namespace {
+
+  /** Scrambles the bits of the given value (the SplitMix64 finalizer). */
+  inline uint64_t mixBits(uint64_t v) {
+    v = (v ^ (v >> 30)) * 0xBF58476D1CE4E5B9ull;
+    v = (v ^ (v >> 27)) * 0x94D049BB133111EBull;
+    return v ^ (v >> 31);
+  }
+
+}
+
+RadianceCache::Cell::Cell()
+  : key(0), radiance(0, 0, 0), weight(0.0f) {}
+
+RadianceCache::RadianceCache() : eye(0, 0, 0), cellScale(1.0f) {}
+
+RadianceCache::RadianceCache(const Vec& e, float scale)
+  : cells(NUM_CELLS), eye(e), cellScale(scale) {}
+
+uint64_t RadianceCache::keyAt(
+  const Vec& point,
+  const Vec& normal,
+  const Vec& jitter
+) const {
+  // Cell sizes are powers of two, so that cells of neighboring sizes nest.
+  float size = max((point - eye).norm() * cellScale, 1e-6f);
+  int level = int(floorf(log2f(size)));
+  Vec scaled = point * ldexpf(1.0f, -level) + jitter;
+
+  // Surfaces facing different ways see different light, so cells are also
+  // split by the axis and sign that the normal is closest to.
+  Vec::Index axis;
+  normal.cwiseAbs().maxCoeff(&axis);
+  int face = int(axis) * 2 + (normal[axis] < 0.0f ? 1 : 0);
+
+  uint64_t hash = mixBits(uint64_t(int64_t(level)));
+  for (int i = 0; i < 3; ++i) {
+    hash = mixBits(hash ^ uint64_t(int64_t(floorf(scaled[i]))));
+  }
+  hash = mixBits(hash ^ uint64_t(face));
+
+  // Zero marks empty cells.
+  return hash == 0 ? 1 : hash;
+}
+
+bool RadianceCache::lookup(
+  Randomness& rng,
+  const Vec& point,
+  const Vec& normal,
+  Vec* radianceOut
+) const {
+  if (cells.empty()) {
+    return false;
+  }
+
+  // Jitter the point by up to half a cell each way, within the surface's
+  // plane so that it stays among the cells that the surface records into.
+  Vec jitter;
+  for (int i = 0; i < 3; ++i) {
+    jitter[i] = rng.nextFloat(-0.5f, 0.5f);
+  }
+  jitter -= normal * normal.dot(jitter);
+
+  uint64_t key = keyAt(point, normal, jitter);
+  for (size_t probe = 0; probe < MAX_PROBES; ++probe) {
+    const Cell& cell = cells[(size_t(key) + probe) & (NUM_CELLS - 1)];
+    uint64_t cellKey = cell.key.load(std::memory_order_relaxed);
+    if (cellKey == key) {
+      if (cell.weight < MIN_CELL_RECORDS) {
+        return false;
+      }
+
+      *radianceOut = cell.radiance;
+      return true;
+    } else if (cellKey == 0) {
+      return false;
+    }
+  }
+
+  return false;
+}
+
+void RadianceCache::record(
+  const Vec& point,
+  const Vec& normal,
+  const Vec& radiance,
+  float weight
+) {
+  if (cells.empty()) {
+    return;
+  }
+
+  uint64_t key = keyAt(point, normal, Vec(0, 0, 0));
+  for (size_t probe = 0; probe < MAX_PROBES; ++probe) {
+    Cell& cell = cells[(size_t(key) + probe) & (NUM_CELLS - 1)];
+    uint64_t cellKey = cell.key.load(std::memory_order_relaxed);
+    if (cellKey == 0) {
+      // Claim the empty cell, unless another thread just claimed it.
+      if (cell.key.compare_exchange_strong(cellKey, key)) {
+        cellKey = key;
+      }
+    }
+
+    if (cellKey == key) {
+      cell.sums[0].add(radiance[0] * weight);
+      cell.sums[1].add(radiance[1] * weight);
+      cell.sums[2].add(radiance[2] * weight);
+      cell.records.add(weight);
+      return;
+    }
+  }
+
+  // The neighborhood of the table is full, so drop the record.
+}
+
+void RadianceCache::update() {
+  for (Cell& cell : cells) {
+    float records = cell.records.load();
+    if (records <= 0.0f) {
+      continue;
+    }
+
+    Vec sum(cell.sums[0].load(), cell.sums[1].load(), cell.sums[2].load());
+    cell.radiance = (cell.radiance * cell.weight + sum)
+      / (cell.weight + records);
+    cell.weight = min(cell.weight + records, MAX_CELL_RECORDS);
+
+    for (int i = 0; i < 3; ++i) {
+      cell.sums[i] = AtomicFloat(0.0f);
+    }
+    cell.records = AtomicFloat(0.0f);
+  }
+}
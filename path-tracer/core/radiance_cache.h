@@ -0,0 +1,121 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "atomic_float.h"
+#include "core.h"
+#include "math.h"
+#include "randomness.h"
+
+/**
+ * A world-space cache of the light arriving at diffuse surfaces, averaged
+ * over the cosine-weighted hemisphere and stored in a hash table of grid
+ * cells. Each cell covers a cube of points whose normals point
+ * the same way, and cubes grow with their distance from the eye so that they
+ * cover about the same number of pixels anywhere in the image. Paths record
+ * the light they find into the cache while an iteration is rendered, and the
+ * cache is updated between iterations; only updated cells are looked up.
+ * Lookups are jittered by up to a cell along the surface, which blends each
+ * cell into its neighbors rather than showing the grid as blocks.
+ *
+ * Based on Binder et al., "Fast Path Space Filtering by Jittered Spatial
+ * Hashing" (2018), and Gautron, "Real-Time Ray-Traced Ambient Occlusion of
+ * Complex Scenes using Spatial Hashing" (2020).
+ */
+class RadianceCache {
+  /** The number of cells in the hash table; a power of two. */
+  static constexpr size_t NUM_CELLS = size_t(1) << 16;
+  /** The number of cells probed for a key before giving up. */
+  static constexpr size_t MAX_PROBES = 8;
+  /** The number of records a cell needs before it is looked up. */
+  static constexpr float MIN_CELL_RECORDS = 16.0f;
+  /**
+   * The most records that a cell's average remembers. Older records fade
+   * away beyond this, so that the cell follows the cells that it depends on
+   * as they converge.
+   */
+  static constexpr float MAX_CELL_RECORDS = 1024.0f;
+
+  struct Cell {
+    std::atomic<uint64_t> key; /**< The key of the cell, or 0 if empty. */
+    AtomicFloat sums[3]; /**< The radiance recorded this iteration. */
+    AtomicFloat records; /**< The weight of the records this iteration. */
+    Vec radiance; /**< The average radiance as of the last update. */
+    float weight; /**< The weight of the records in the average. */
+
+    Cell();
+  };
+
+  std::vector<Cell> cells; /**< The hash table of cells. */
+  Vec eye; /**< The point that cells grow away from. */
+  float cellScale; /**< The size of a cell, per unit of distance from eye. */
+
+  /**
+   * Returns the key of the cell containing the given point and normal.
+   *
+   * @param point  the point to find the cell of
+   * @param normal the surface normal at the point
+   * @param jitter the offset of the point, in units of its cell's size
+   */
+  uint64_t keyAt(const Vec& point, const Vec& normal, const Vec& jitter)
+    const;
+
+public:
+  /**
+   * Constructs a cache with no cells, which never knows about any point.
+   */
+  RadianceCache();
+
+  /**
+   * Constructs an empty cache.
+   *
+   * @param e     the point that cells grow away from, usually the eye
+   * @param scale the size of a cell, per unit of distance from e
+   */
+  RadianceCache(const Vec& e, float scale);
+
+  /** Returns true if the cache has cells, and so can learn anything. */
+  inline bool enabled() const { return !cells.empty(); }
+
+  /**
+   * Looks up the average light arriving near the given point, in a cell
+   * picked at random within about a cell's size of it along the surface.
+   *
+   * @param rng               the per-thread RNG in use
+   * @param point             the point to look up
+   * @param normal            the surface normal at the point
+   * @param radianceOut [out] the average radiance arriving at the point
+   * @returns                 true if the cache knew about the point
+   */
+  bool lookup(
+    Randomness& rng,
+    const Vec& point,
+    const Vec& normal,
+    Vec* radianceOut
+  ) const;
+
+  /**
+   * Records light arriving at the given point. Directions that were not
+   * sampled in proportion to the cosine must be weighted by the ratio of the
+   * cosine-weighted PDF to the PDF they were sampled with. This may be called
+   * by many threads at once.
+   *
+   * @param point    the point that the light arrived at
+   * @param normal   the surface normal at the point
+   * @param radiance the radiance that arrived
+   * @param weight   the weight of the record
+   */
+  void record(
+    const Vec& point,
+    const Vec& normal,
+    const Vec& radiance,
+    float weight
+  );
+
+  /**
+   * Folds the light recorded since the last update into each cell's average,
+   * so that the next iteration can look it up. This must not be called while
+   * an iteration is rendering.
+   */
+  void update();
+};
@@ -1,5 +1,7 @@
 #pragma once
+#include <cmath>
 #include <random>
+#include <vector>
 
 /**
  * A unified RNG capable of generating random floating-point and integer
@@ -26,6 +28,14 @@ class Randomness {
    * The engine used internally for the RNG.
    */
   std::mt19937 rng;
+  /**
+   * The primary samples being replayed, or null if samples are random.
+   */
+  std::vector<float>* replaying;
+  /**
+   * The index of the next primary sample to replay.
+   */
+  size_t replayIndex;
 
   /**
    * Returns a seed based on true device randomness.
@@ -42,13 +52,28 @@ public:
    * Constructs a randomness object from a truly random seed.
    */
   Randomness()
-    : unitDist(), intDist(), unsignedDist(), normalDist(), rng(createSeed()) {}
+    : unitDist(), intDist(), unsignedDist(), normalDist(), rng(createSeed()),
+      replaying(nullptr), replayIndex(0) {}
 
   /**
    * Constructs a randomness object from the given seed.
    */
   Randomness(unsigned seed)
-    : unitDist(), intDist(), unsignedDist(), rng(seed) {}
+    : unitDist(), intDist(), unsignedDist(), rng(seed), replaying(nullptr),
+      replayIndex(0) {}
+
+  /**
+   * Makes the following unit floats come from the given primary samples, in
+   * order, instead of being random. Samples past the end of the list are
+   * generated randomly and appended to it. This lets a path be reproduced,
+   * or changed slightly, by editing its primary samples.
+   *
+   * @param samples the primary samples to replay, or null to stop replaying
+   */
+  inline void replay(std::vector<float>* samples) {
+    replaying = samples;
+    replayIndex = 0;
+  }
 
   /**
    * Samples a random int.
@@ -63,24 +88,42 @@ public:
   /**
    * Samples a random float between 0 (inclusive) and 1 (exclusive).
    */
-  inline float nextUnitFloat() { return unitDist(rng); }
+  inline float nextUnitFloat() {
+    if (!replaying) {
+      return unitDist(rng);
+    }
+
+    if (replayIndex == replaying->size()) {
+      replaying->push_back(unitDist(rng));
+    }
+    return (*replaying)[replayIndex++];
+  }
 
   /**
    * Samples a random float between 0 (inclusive) and max (exclusive).
    */
   inline float nextFloat(float max) {
-    return max * unitDist(rng);
+    return max * nextUnitFloat();
   }
 
   /**
    * Samples a random float between min (inclusive) and max (exclusive).
    */
   inline float nextFloat(float min, float max) {
-    return min + (max - min) * unitDist(rng);
+    return min + (max - min) * nextUnitFloat();
   }
 
   /**
    * Samples a normally-distributed float with mean 0 and standard deviation 1.
    */
-  inline float nextNormalFloat() { return normalDist(rng); }
+  inline float nextNormalFloat() {
+    if (!replaying) {
+      return normalDist(rng);
+    }
+
+    // Box-Muller transform, so that the result depends only on two samples.
+    float u1 = nextUnitFloat();
+    float u2 = nextUnitFloat();
+    return sqrtf(-2.0f * logf(1.0f - u1)) * cosf(6.28318531f * u2);
+  }
 };
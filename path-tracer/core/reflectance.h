@@ -0,0 +1,71 @@
+#pragma once
+#include "core.h"
+
+/**
+ * The closed-form BSDFs and PDFs of the built-in materials. The material
+ * classes, shading contexts and MaterialTable all evaluate them through
+ * these functions, so that each formula and hemisphere test is written only
+ * once. Directions are in the local (normal) coordinate system.
+ */
+namespace reflectance {
+
+  /** Returns the Lambertian BSDF of the given albedo. */
+  inline Vec lambertScale(const Vec& albedo) {
+    return albedo * math::INV_PI;
+  }
+
+  /**
+   * Evaluates a Lambertian BSDF.
+   *
+   * @param scale       the BSDF on the incoming side; see lambertScale
+   * @param cosIncoming the cosine of the incoming direction with the normal
+   * @param cosOutgoing the cosine of the outgoing direction with the normal
+   */
+  inline Vec lambert(const Vec& scale, float cosIncoming, float cosOutgoing) {
+    return math::sameHemisphere(cosIncoming, cosOutgoing)
+      ? scale
+      : Vec(0, 0, 0);
+  }
+
+  /**
+   * Returns the probability of cosine-weighted sampling on the incoming side;
+   * the cosines are as for lambert.
+   */
+  inline float lambertPDF(float cosIncoming, float cosOutgoing) {
+    return math::sameHemisphere(cosIncoming, cosOutgoing)
+      ? fabsf(cosOutgoing) * math::INV_PI
+      : 0.0f;
+  }
+
+  /**
+   * Returns the scale of the Phong BSDF of the given color and exponent. See
+   * Lafortune & Willems <http://www.graphics.cornell.edu/~eric/Phong.html>.
+   */
+  inline Vec phongScale(const Vec& color, float exponent) {
+    return color * (exponent + 2.0f) / math::TWO_PI;
+  }
+
+  /** Returns the scale of the Phong PDF of the given exponent. */
+  inline float phongPDFScale(float exponent) {
+    return (exponent + 1.0f) / math::TWO_PI;
+  }
+
+  /** Returns the perfect (mirror) reflection of the incoming direction. */
+  inline Vec phongReflect(const Vec& incoming) {
+    return Vec(-incoming.x(), -incoming.y(), incoming.z());
+  }
+
+  /**
+   * Returns the cosine of the angle between the outgoing direction and the
+   * perfect reflection, or 0 if the directions are on opposite sides. The
+   * Phong BSDF and PDF are their scales times this to the exponent.
+   */
+  inline float phongCosine(const Vec& incoming, const Vec& outgoing) {
+    if (!math::localSameHemisphere(incoming, outgoing)) {
+      return 0.0f;
+    }
+
+    return max(0.0f, outgoing.dot(phongReflect(incoming)));
+  }
+
+}
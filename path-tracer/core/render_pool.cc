@@ -0,0 +1,72 @@
+#include "render_pool.h"
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <boost/format.hpp>
+
+using boost::format;
+
+namespace {
+
+  /** The size requested for the shared pool; 0 for one per core. */
+  std::atomic<int> requestedThreads(0);
+
+  /** Whether the shared pool has been created. */
+  std::atomic<bool> sharedCreated(false);
+
+}
+
+RenderPool::RenderPool(int numThreads)
+  : threads(numThreads), pool(numThreads), lock(), turn(),
+    nextTicket(0), servingTicket(0) {}
+
+RenderPool& RenderPool::shared() {
+  static RenderPool sharedPool([] {
+    int numThreads = requestedThreads.load();
+    if (numThreads <= 0) {
+      numThreads = int(std::thread::hardware_concurrency());
+    }
+    if (numThreads <= 0) {
+      numThreads = DEFAULT_THREADS;
+    }
+    sharedCreated = true;
+    return numThreads;
+  }());
+  return sharedPool;
+}
+
+void RenderPool::setSharedSize(int numThreads) {
+  if (numThreads < 0) {
+    throw std::runtime_error(
+      str(format("Cannot render with %1% threads") % numThreads)
+    );
+  }
+
+  if (!sharedCreated.load()) {
+    requestedThreads = numThreads;
+  } else if (numThreads > 0 && numThreads != shared().size()) {
+    throw std::runtime_error(
+      str(format("Cannot resize the render threads from %1% to %2%")
+          % shared().size() % numThreads)
+    );
+  }
+}
+
+void RenderPool::dispatch(
+  int numTasks,
+  sdk_util::WorkFunction work,
+  void* data
+) {
+  // Take a ticket and wait for our turn, so that dispatches run in the
+  // order that they were asked for.
+  std::unique_lock<std::mutex> guard(lock);
+  unsigned long ticket = nextTicket++;
+  turn.wait(guard, [this, ticket] { return servingTicket == ticket; });
+  guard.unlock();
+
+  pool.Dispatch(numTasks, work, data);
+
+  guard.lock();
+  servingTicket++;
+  turn.notify_all();
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include "sdk_util/thread_pool.h"
+
+/**
+ * The worker threads that every camera renders with. There is one pool for
+ * the whole process, sized to the machine, so that a scene with several
+ * cameras does not run more threads than there are cores.
+ *
+ * Renders that dispatch at the same time take turns in the order that they
+ * asked, each getting all of the threads for one dispatch; since a dispatch
+ * is at most an iteration's worth of work, concurrent renders share the
+ * machine fairly without one starving another.
+ */
+class RenderPool {
+  /** The number of threads when the machine does not report its cores. */
+  static constexpr int DEFAULT_THREADS = 4;
+
+  const int threads; /**< The number of worker threads. */
+  sdk_util::ThreadPool pool; /**< The worker threads. */
+
+  std::mutex lock; /**< Guards the tickets. */
+  std::condition_variable turn; /**< Signals that a dispatch finished. */
+  unsigned long nextTicket; /**< The ticket given to the next dispatch. */
+  unsigned long servingTicket; /**< The ticket of the running dispatch. */
+
+  /**
+   * Constructs a pool.
+   *
+   * @param numThreads the number of worker threads
+   */
+  RenderPool(int numThreads);
+
+public:
+  RenderPool(const RenderPool&) = delete;
+  RenderPool& operator=(const RenderPool&) = delete;
+
+  /**
+   * Returns the pool shared by the whole process, creating it on the first
+   * call with the size set by RenderPool::setSharedSize, or else one thread
+   * per hardware thread.
+   */
+  static RenderPool& shared();
+
+  /**
+   * Sets the number of threads that the shared pool is created with. It
+   * cannot be resized once it exists, so this must come before the first
+   * call to RenderPool::shared, unless it asks for the same size.
+   *
+   * @param numThreads the number of worker threads; 0 for one per hardware
+   *                   thread
+   *
+   * @throws std::runtime_error if the shared pool already exists with a
+   *                            different size
+   */
+  static void setSharedSize(int numThreads);
+
+  /** Returns the number of worker threads. */
+  inline int size() const { return threads; }
+
+  /**
+   * Runs tasks on the worker threads and waits for all of them to finish,
+   * first waiting for the dispatches that asked earlier. Must not be called
+   * from a task.
+   *
+   * @param numTasks the number of tasks to run
+   * @param work     the function that runs each task, given its index
+   * @param data     the data passed to each task
+   */
+  void dispatch(int numTasks, sdk_util::WorkFunction work, void* data);
+};
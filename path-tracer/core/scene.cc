@@ -3,23 +3,28 @@
 #include <boost/format.hpp>
 #include "camera.h"
 #include "light.h"
+#include "infinite_light.h"
 #include "material.h"
 #include "geom.h"
 #include "materials/all.h"
 #include "geoms/all.h"
+#include "lights/all.h"
 #include "node.h"
+#include "render_pool.h"
 
 using boost::property_tree::ptree;
 using boost::format;
 
 Scene::Scene(std::string jsonFile)
-  : lights(), materials(), geometry(), cameras()
+  : lights(), environments(), materials(), geometry(), cameras()
 {
   try {
     ptree pt;
     read_json(jsonFile, pt);
 
+    readSettings(pt);
     readLights(pt);
+    readEnvironments(pt);
     readMats(pt);
     readGeoms(pt);
     readCameras(pt);
@@ -30,13 +35,15 @@ Scene::Scene(std::string jsonFile)
 }
 
 Scene::Scene(std::istream& jsonStream)
-  : lights(), materials(), geometry(), cameras()
+  : lights(), environments(), materials(), geometry(), cameras()
 {
   try {
     ptree pt;
     read_json(jsonStream, pt);
 
+    readSettings(pt);
     readLights(pt);
+    readEnvironments(pt);
     readMats(pt);
     readGeoms(pt);
     readCameras(pt);
@@ -55,6 +62,10 @@ void Scene::cleanUp() {
     delete pair.second;
   }
 
+  for (auto& pair : environments) {
+    delete pair.second;
+  }
+
   for (auto& pair : materials) {
     delete pair.second;
   }
@@ -104,6 +115,10 @@ void Scene::readMultiple(
   }
 }
 
+void Scene::readSettings(const ptree& root) {
+  RenderPool::setSharedSize(root.get<int>("threads", 0));
+}
+
 void Scene::readLights(const ptree& root) {
   static const LookupMap<const AreaLight*> lightLookup = {
     { "area", [](const Node& n) { return new AreaLight(n); } }
@@ -112,6 +127,19 @@ void Scene::readLights(const ptree& root) {
   readMultiple<const AreaLight*>(root, "lights", lightLookup, lights);
 }
 
+void Scene::readEnvironments(const ptree& root) {
+  using namespace lights;
+  static const LookupMap<const InfiniteLight*> environmentLookup = {
+    { "environment", [](const Node& n) { return new Environment(n); } }
+  };
+
+  if (root.get_child_optional("environments")) {
+    readMultiple<const InfiniteLight*>(
+      root, "environments", environmentLookup, environments
+    );
+  }
+}
+
 void Scene::readMats(const ptree& root) {
   using namespace materials;
   static const LookupMap<const Material*> materialLookup = {
@@ -8,6 +8,7 @@
 #include "core.h"
 
 class AreaLight;
+class InfiniteLight;
 class Material;
 class Geom;
 class Camera;
@@ -22,6 +23,8 @@ class Scene {
 
   /** Lights read from scene file. */
   std::map<std::string, const AreaLight*> lights;
+  /** Environment lights read from scene file. */
+  std::map<std::string, const InfiniteLight*> environments;
   /** Materials read from scene file. */
   std::map<std::string, const Material*> materials;
   /** Geometry read from file. */
@@ -48,8 +51,19 @@ class Scene {
     const LookupMap<T> lookup,
     std::map<std::string, T>& storage
   );
+  /**
+   * Reads the settings for the whole process in the given property tree,
+   * which are all optional: "threads", the number of render threads (0 for
+   * one per hardware thread).
+   */
+  void readSettings(const boost::property_tree::ptree& root);
   /** Reads all of the lights in the given property tree. */
   void readLights(const boost::property_tree::ptree& root);
+  /**
+   * Reads all of the environment lights in the given property tree. The
+   * section is optional; scenes without it have no environment lights.
+   */
+  void readEnvironments(const boost::property_tree::ptree& root);
   /** Reads all of the materials in the given property tree. */
   void readMats(const boost::property_tree::ptree& root);
   /** Reads all of the geometry in the given property tree. */
@@ -0,0 +1,263 @@
+#include "sd_tree.h"
+
+using std::max;
+using std::min;
+
+DTree::Node::Node() : children{0, 0, 0, 0} {}
+
+DTree::DTree() : nodes(1) {}
+
+Vec2 DTree::dirToSquare(const Vec& dir) {
+  float cosTheta = math::clamp(dir.z(), -1.0f, 1.0f);
+  float phi = atan2f(dir.y(), dir.x());
+  if (phi < 0.0f) {
+    phi += math::TWO_PI;
+  }
+
+  return Vec2(
+    math::clamp(0.5f * (cosTheta + 1.0f), 0.0f, 1.0f),
+    math::clamp(phi / math::TWO_PI, 0.0f, 1.0f)
+  );
+}
+
+Vec DTree::squareToDir(const Vec2& p) {
+  float cosTheta = 2.0f * p.x() - 1.0f;
+  float sinTheta = sqrtf(max(0.0f, 1.0f - cosTheta * cosTheta));
+  float phi = math::TWO_PI * p.y();
+  return Vec(sinTheta * cosf(phi), sinTheta * sinf(phi), cosTheta);
+}
+
+Vec DTree::sample(Randomness& rng, float* pdfOut) const {
+  // Descend, picking quadrants in proportion to their energy. Each step
+  // quarters the area, so the density grows by 4 * (share of energy).
+  Vec2 origin(0, 0);
+  float size = 1.0f;
+  float pdf = 1.0f;
+  size_t idx = 0;
+  while (true) {
+    const Node& node = nodes[idx];
+    float total = node.total();
+    if (total <= 0.0f) {
+      // Can only happen through rounding; sample the node uniformly.
+      origin += Vec2(rng.nextFloat(size), rng.nextFloat(size));
+      size = 0.0f;
+      break;
+    }
+
+    int quadrant = 3;
+    float target = rng.nextFloat(total);
+    for (int i = 0; i < 3; ++i) {
+      float s = node.sums[i].load();
+      if (target < s) {
+        quadrant = i;
+        break;
+      }
+      target -= s;
+    }
+
+    pdf *= 4.0f * node.sums[quadrant].load() / total;
+    size *= 0.5f;
+    origin += Vec2(float(quadrant & 1), float(quadrant >> 1)) * size;
+
+    if (node.children[quadrant] == 0) {
+      break;
+    }
+    idx = node.children[quadrant];
+  }
+
+  Vec2 p = origin + Vec2(rng.nextFloat(size), rng.nextFloat(size));
+
+  // The cylindrical mapping takes the unit square to 4 * Pi steradians.
+  *pdfOut = pdf / math::FOUR_PI;
+  return squareToDir(p);
+}
+
+float DTree::pdf(const Vec& dir) const {
+  Vec2 p = dirToSquare(dir);
+  float pdf = 1.0f;
+  size_t idx = 0;
+  while (true) {
+    const Node& node = nodes[idx];
+    float total = node.total();
+    if (total <= 0.0f) {
+      return 0.0f;
+    }
+
+    int quadrant = (p.x() >= 0.5f ? 1 : 0) + (p.y() >= 0.5f ? 2 : 0);
+    pdf *= 4.0f * node.sums[quadrant].load() / total;
+
+    if (node.children[quadrant] == 0) {
+      break;
+    }
+    idx = node.children[quadrant];
+    p = Vec2(
+      2.0f * p.x() - float(quadrant & 1),
+      2.0f * p.y() - float(quadrant >> 1)
+    );
+  }
+
+  return pdf / math::FOUR_PI;
+}
+
+void DTree::record(const Vec& dir, float energy) {
+  Vec2 p = dirToSquare(dir);
+  size_t idx = 0;
+  while (true) {
+    Node& node = nodes[idx];
+    int quadrant = (p.x() >= 0.5f ? 1 : 0) + (p.y() >= 0.5f ? 2 : 0);
+    node.sums[quadrant].add(energy);
+
+    if (node.children[quadrant] == 0) {
+      break;
+    }
+    idx = node.children[quadrant];
+    p = Vec2(
+      2.0f * p.x() - float(quadrant & 1),
+      2.0f * p.y() - float(quadrant >> 1)
+    );
+  }
+}
+
+DTree DTree::cleared() const {
+  DTree result(*this);
+  for (Node& node : result.nodes) {
+    for (int i = 0; i < 4; ++i) {
+      node.sums[i] = AtomicFloat(0.0f);
+    }
+  }
+  return result;
+}
+
+DTree DTree::refined(float splitFraction, int maxDepth) const {
+  struct Pending {
+    size_t newIdx; /**< The node in the new tree. */
+    long oldIdx; /**< The matching node in this tree, or -1 if none. */
+    int depth; /**< The depth of the node. */
+  };
+
+  DTree result;
+  result.nodes[0] = nodes[0];
+  float total = this->total();
+  if (total <= 0.0f) {
+    return result;
+  }
+
+  std::vector<Pending> stack;
+  stack.push_back(Pending{0, 0, 1});
+  while (!stack.empty()) {
+    Pending cur = stack.back();
+    stack.pop_back();
+
+    for (int i = 0; i < 4; ++i) {
+      float energy = result.nodes[cur.newIdx].sums[i].load();
+      result.nodes[cur.newIdx].children[i] = 0;
+      if (energy <= total * splitFraction || cur.depth >= maxDepth) {
+        // Collapse; the quadrant's sum already includes any children.
+        continue;
+      }
+
+      size_t childIdx = result.nodes.size();
+      long oldChildIdx = -1;
+      if (cur.oldIdx >= 0 && nodes[size_t(cur.oldIdx)].children[i] != 0) {
+        oldChildIdx = long(nodes[size_t(cur.oldIdx)].children[i]);
+      }
+
+      if (oldChildIdx >= 0) {
+        result.nodes.push_back(nodes[size_t(oldChildIdx)]);
+      } else {
+        // Newly subdivided, so spread the energy evenly.
+        result.nodes.push_back(Node());
+        for (int j = 0; j < 4; ++j) {
+          result.nodes[childIdx].sums[j] = AtomicFloat(0.25f * energy);
+        }
+      }
+
+      result.nodes[cur.newIdx].children[i] = uint32_t(childIdx);
+      stack.push_back(Pending{childIdx, oldChildIdx, cur.depth + 1});
+    }
+  }
+
+  return result;
+}
+
+SDTree::Node::Node(int d) : children{0, 0}, depth(d) {}
+
+SDTree::SDTree(const BBox& b) : bounds(b), nodes(1, Node(0)) {}
+
+size_t SDTree::leafAt(const Vec& point) const {
+  BBox box = bounds;
+  size_t idx = 0;
+  while (nodes[idx].children[0] != 0) {
+    int axis = nodes[idx].depth % 3;
+    float mid = 0.5f * (box.lower[axis] + box.upper[axis]);
+    if (point[axis] < mid) {
+      box.upper[axis] = mid;
+      idx = nodes[idx].children[0];
+    } else {
+      box.lower[axis] = mid;
+      idx = nodes[idx].children[1];
+    }
+  }
+
+  return idx;
+}
+
+const DTree* SDTree::samplingTree(const Vec& point) const {
+  const DTree& tree = nodes[leafAt(point)].sampling;
+  if (tree.total() <= 0.0f) {
+    return nullptr;
+  }
+
+  return &tree;
+}
+
+void SDTree::record(const Vec& point, const Vec& dir, float energy) {
+  if (!(energy > 0.0f) || !std::isfinite(energy)) {
+    return;
+  }
+
+  Node& leaf = nodes[leafAt(point)];
+  leaf.building.record(dir, energy);
+  leaf.records.add(1.0f);
+}
+
+void SDTree::refine() {
+  // Split busy leaves in half; both halves start from the parent's
+  // distribution, since that is the best guess available for either.
+  size_t count = nodes.size();
+  for (size_t i = 0; i < count; ++i) {
+    if (nodes[i].children[0] != 0
+        || nodes[i].records.load() <= SPATIAL_SPLIT_RECORDS
+        || nodes[i].depth >= MAX_SPATIAL_DEPTH) {
+      continue;
+    }
+
+    for (int j = 0; j < 2; ++j) {
+      nodes[i].children[j] = uint32_t(nodes.size());
+      nodes.push_back(Node(nodes[i].depth + 1));
+      nodes.back().building = nodes[i].building;
+    }
+    nodes[i].building = DTree();
+    nodes[i].sampling = DTree();
+  }
+
+  // Adapt every leaf's directional tree, and start sampling from it. The
+  // next iteration records afresh into the adapted structure, so each
+  // distribution comes from one iteration's paths, which guide better than
+  // the paths of earlier, less guided iterations. A leaf that received no
+  // light keeps sampling what it learned before.
+  for (Node& node : nodes) {
+    if (node.children[0] != 0) {
+      continue;
+    }
+
+    if (node.building.total() > 0.0f) {
+      node.sampling = node.building.refined(
+        DIRECTIONAL_SPLIT_FRACTION,
+        MAX_DIRECTIONAL_DEPTH
+      );
+      node.building = node.sampling.cleared();
+    }
+    node.records = AtomicFloat(0.0f);
+  }
+}
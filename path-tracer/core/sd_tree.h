@@ -0,0 +1,167 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "atomic_float.h"
+#include "core.h"
+#include "math.h"
+#include "randomness.h"
+
+/**
+ * A distribution over the sphere of directions, stored as a quadtree over
+ * the cylindrical coordinates (cos[theta], phi), which map directions to the
+ * unit square while preserving area. Each node stores the energy arriving
+ * through each of its four quadrants, and quadrants that receive a large
+ * share of the energy are subdivided further.
+ *
+ * Taken from Muller et al., "Practical Path Guiding for Efficient
+ * Light-Transport Simulation" (2017).
+ */
+class DTree {
+  struct Node {
+    AtomicFloat sums[4]; /**< The energy arriving through each quadrant. */
+    /** The node subdividing each quadrant, or 0 if the quadrant is a leaf. */
+    uint32_t children[4];
+
+    Node();
+    inline float total() const {
+      return sums[0].load() + sums[1].load() + sums[2].load() + sums[3].load();
+    }
+  };
+
+  std::vector<Node> nodes; /**< The nodes of the tree; the root is first. */
+
+  /** Maps a direction onto the unit square. */
+  static Vec2 dirToSquare(const Vec& dir);
+  /** Maps a point on the unit square back to a direction. */
+  static Vec squareToDir(const Vec2& p);
+
+public:
+  /**
+   * Constructs a tree with a single node and no energy.
+   */
+  DTree();
+
+  /** Returns the total energy recorded in the tree. */
+  inline float total() const { return nodes[0].total(); }
+
+  /** Returns the number of nodes in the tree. */
+  inline size_t size() const { return nodes.size(); }
+
+  /**
+   * Samples a direction in proportion to the recorded energy. The tree must
+   * have some energy.
+   *
+   * @param rng          the per-thread RNG in use
+   * @param pdfOut [out] the probability of the direction, with respect to
+   *                     solid angle
+   * @returns            the sampled direction
+   */
+  Vec sample(Randomness& rng, float* pdfOut) const;
+
+  /**
+   * Returns the probability that DTree::sample would pick the given
+   * direction, with respect to solid angle.
+   */
+  float pdf(const Vec& dir) const;
+
+  /**
+   * Adds energy arriving from the given direction. This may be called by
+   * many threads at once.
+   *
+   * @param dir    the direction that the energy arrived from
+   * @param energy the energy to record
+   */
+  void record(const Vec& dir, float energy);
+
+  /**
+   * Returns a copy of the tree whose structure is adapted to its energy: any
+   * quadrant receiving more than the given fraction of the total energy is
+   * subdivided, and any other quadrant is collapsed into a leaf. The energy
+   * recorded so far is carried over into the new structure.
+   *
+   * @param splitFraction the fraction of the energy above which quadrants are
+   *                      subdivided
+   * @param maxDepth      the maximum depth of the tree
+   */
+  DTree refined(float splitFraction, int maxDepth) const;
+
+  /**
+   * Returns a copy of the tree with the same structure and no energy.
+   */
+  DTree cleared() const;
+};
+
+/**
+ * A spatial binary tree over the scene whose leaves each hold a DTree, which
+ * learns the distribution of light arriving in that region. Paths record
+ * the light they find into the tree while an iteration is rendered, and the
+ * tree is refined between iterations; the learned distributions are only
+ * used for sampling once they have been refined.
+ *
+ * Taken from Muller et al., "Practical Path Guiding for Efficient
+ * Light-Transport Simulation" (2017).
+ */
+class SDTree {
+  /**
+   * The number of records that a leaf must receive in one iteration in order
+   * to be split in half.
+   */
+  static constexpr float SPATIAL_SPLIT_RECORDS = 4000.0f;
+  /** The maximum depth of the spatial tree. */
+  static constexpr int MAX_SPATIAL_DEPTH = 32;
+  /**
+   * The fraction of a leaf's energy above which a quadrant of its directional
+   * tree is subdivided.
+   */
+  static constexpr float DIRECTIONAL_SPLIT_FRACTION = 0.01f;
+  /** The maximum depth of the directional trees. */
+  static constexpr int MAX_DIRECTIONAL_DEPTH = 20;
+
+  struct Node {
+    /** The two halves of the node, or 0 if the node is a leaf. */
+    uint32_t children[2];
+    int depth; /**< The depth of the node; it is split along depth % 3. */
+    DTree building; /**< The distribution being recorded into. */
+    DTree sampling; /**< The distribution being sampled from. */
+    AtomicFloat records; /**< The number of records this iteration. */
+
+    Node(int d);
+  };
+
+  BBox bounds; /**< The region covered by the tree. */
+  std::vector<Node> nodes; /**< The nodes of the tree; the root is first. */
+
+  /** Returns the index of the leaf containing the given point. */
+  size_t leafAt(const Vec& point) const;
+
+public:
+  /**
+   * Constructs a tree covering the given bounds with a single leaf.
+   */
+  SDTree(const BBox& b = BBox());
+
+  /**
+   * Returns the learned distribution of light arriving at the given point,
+   * or null if nothing has been learned there yet.
+   */
+  const DTree* samplingTree(const Vec& point) const;
+
+  /**
+   * Records light arriving at the given point. This may be called by many
+   * threads at once.
+   *
+   * @param point  the point that the light arrived at
+   * @param dir    the direction that the light arrived from
+   * @param energy the radiance that arrived, divided by the probability of
+   *               sampling its direction
+   */
+  void record(const Vec& point, const Vec& dir, float energy);
+
+  /**
+   * Splits leaves that received many records and adapts the directional
+   * trees to the light recorded this iteration, so that the next iteration
+   * samples from them and records into empty copies of them. This must not
+   * be called while an iteration is rendering.
+   */
+  void refine();
+};
@@ -0,0 +1,18 @@
+#include "shading_context.h"
+#include "material.h"
+#include "reflectance.h"
+
+ShadingContext::ShadingContext(
+  const Intersection& i,
+  const Vec& in,
+  const Material* m
+) : isect(i), mat(m), incoming(in),
+    directIlluminate(m->shouldDirectIlluminate()),
+    lambertian(m->isLambertian()),
+    lambertBsdf(
+      lambertian ? reflectance::lambertScale(m->baseColor()) : Vec(0, 0, 0)
+    )
+{
+  math::coordSystem(isect.normal, &tangent, &binormal);
+  incomingLocal = toLocal(incoming);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "core.h"
+#include "math.h"
+
+class Material;
+
+/**
+ * The shading frame and material of a path vertex, built once when the path
+ * arrives at a surface so that the lights and the material do not rebuild it
+ * for every direction they evaluate or sample there.
+ */
+struct ShadingContext {
+  Intersection isect; /**< The position and normal of the surface. */
+  const Material* mat; /**< The material of the surface. */
+  Vec tangent; /**< The first tangent of the shading frame. */
+  Vec binormal; /**< The second tangent of the shading frame. */
+  Vec incoming; /**< The direction back along the arriving ray. */
+  Vec incomingLocal; /**< The incoming direction in the shading frame. */
+  /** Whether the material is lit directly; see Material. */
+  bool directIlluminate;
+  /**
+   * Whether the material reflects the same amount in every direction on the
+   * incoming side, in which case lambertBsdf is its BSDF.
+   */
+  bool lambertian;
+  Vec lambertBsdf; /**< The BSDF, if the material is Lambertian. */
+
+  /**
+   * Constructs the context for a path arriving at a surface.
+   *
+   * @param i  the intersection on the surface
+   * @param in the direction back along the arriving ray
+   * @param m  the material of the surface
+   */
+  ShadingContext(const Intersection& i, const Vec& in, const Material* m);
+
+  /** Converts a world-space direction into the shading frame. */
+  inline Vec toLocal(const Vec& world) const {
+    return math::worldToLocal(world, tangent, binormal, isect.normal);
+  }
+
+  /** Converts a direction in the shading frame into world space. */
+  inline Vec toWorld(const Vec& local) const {
+    return math::localToWorld(local, tangent, binormal, isect.normal);
+  }
+};
@@ -0,0 +1,127 @@
+#include "tile_scheduler.h"
+#include <algorithm>
+
+namespace {
+
+  /** Spreads the low 16 bits of x out to the even bits. */
+  inline uint32_t spreadBits(uint32_t x) {
+    x &= 0xffff;
+    x = (x | (x << 8)) & 0x00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+  }
+
+  /** Returns the position of a tile along the Morton curve. */
+  inline uint32_t mortonCode(long tileX, long tileY) {
+    return spreadBits(uint32_t(tileX)) | (spreadBits(uint32_t(tileY)) << 1);
+  }
+
+  /** Packs a run of tiles [begin, end) into a single word. */
+  inline uint64_t packRange(size_t begin, size_t end) {
+    return (uint64_t(begin) << 32) | uint64_t(end);
+  }
+
+  /** Returns the first tile in a packed run. */
+  inline size_t rangeBegin(uint64_t range) {
+    return size_t(range >> 32);
+  }
+
+  /** Returns one past the last tile in a packed run. */
+  inline size_t rangeEnd(uint64_t range) {
+    return size_t(range & 0xffffffff);
+  }
+
+}
+
+TileScheduler::TileScheduler(long w, long h, int workers)
+  : tiles(), queues(size_t(std::max(workers, 1))), tilesDone(0)
+{
+  long tilesX = (w + TILE_SIZE - 1) / TILE_SIZE;
+  long tilesY = (h + TILE_SIZE - 1) / TILE_SIZE;
+
+  typedef std::pair<uint32_t, Tile> OrderedTile;
+  std::vector<OrderedTile> ordered;
+  for (long ty = 0; ty < tilesY; ++ty) {
+    for (long tx = 0; tx < tilesX; ++tx) {
+      Tile tile;
+      tile.x0 = tx * TILE_SIZE;
+      tile.y0 = ty * TILE_SIZE;
+      tile.x1 = std::min(tile.x0 + TILE_SIZE, w);
+      tile.y1 = std::min(tile.y0 + TILE_SIZE, h);
+      ordered.push_back(std::make_pair(mortonCode(tx, ty), tile));
+    }
+  }
+
+  std::sort(
+    ordered.begin(),
+    ordered.end(),
+    [](const OrderedTile& a, const OrderedTile& b) {
+      return a.first < b.first;
+    }
+  );
+  for (const auto& entry : ordered) {
+    tiles.push_back(entry.second);
+  }
+
+  reset();
+}
+
+void TileScheduler::reset() {
+  // Contiguous runs keep each worker on one part of the image.
+  size_t n = queues.size();
+  for (size_t i = 0; i < n; ++i) {
+    queues[i].range.store(
+      packRange(tiles.size() * i / n, tiles.size() * (i + 1) / n),
+      std::memory_order_relaxed
+    );
+  }
+  tilesDone.store(0, std::memory_order_relaxed);
+}
+
+bool TileScheduler::next(int worker, size_t* tileOut) {
+  // Take from the front of our own run.
+  std::atomic<uint64_t>& own = queues[size_t(worker)].range;
+  uint64_t range = own.load(std::memory_order_acquire);
+  while (rangeBegin(range) < rangeEnd(range)) {
+    uint64_t rest = packRange(rangeBegin(range) + 1, rangeEnd(range));
+    if (own.compare_exchange_weak(range, rest, std::memory_order_acq_rel)) {
+      *tileOut = rangeBegin(range);
+      return true;
+    }
+  }
+
+  // Steal the back half of the next run that has any tiles left, keeping
+  // the first stolen tile and queueing the rest as our own run. Only we add
+  // to our run, and it is empty, so nobody else changes it meanwhile.
+  size_t n = queues.size();
+  for (size_t i = 1; i < n; ++i) {
+    std::atomic<uint64_t>& victim = queues[(size_t(worker) + i) % n].range;
+    range = victim.load(std::memory_order_acquire);
+    while (rangeBegin(range) < rangeEnd(range)) {
+      size_t begin = rangeBegin(range);
+      size_t end = rangeEnd(range);
+      size_t middle = begin + (end - begin) / 2;
+      if (victim.compare_exchange_weak(
+            range,
+            packRange(begin, middle),
+            std::memory_order_acq_rel
+          )) {
+        own.store(packRange(middle + 1, end), std::memory_order_release);
+        *tileOut = middle;
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+float TileScheduler::progress() const {
+  if (tiles.empty()) {
+    return 1.0f;
+  }
+  return float(tilesDone.load(std::memory_order_relaxed))
+    / float(tiles.size());
+}
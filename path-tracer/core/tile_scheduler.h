@@ -0,0 +1,95 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Splits an image into square tiles and hands them out to a fixed number of
+ * worker threads, for one iteration at a time. The tiles are numbered along
+ * a Morton (Z-order) curve, so that consecutive tiles are close together on
+ * the image and touch nearby parts of the scene.
+ *
+ * Each worker starts with its own contiguous run of tiles, which it takes
+ * from the front. A worker whose run is empty steals the back half of
+ * another worker's run, so that expensive tiles (e.g. through glass) do not
+ * leave the other workers idle at the end of an iteration. Every tile is
+ * handed out exactly once per iteration.
+ */
+class TileScheduler {
+public:
+  /** The width and height of a tile, in pixels. */
+  static constexpr long TILE_SIZE = 16;
+
+  /** A rectangle of pixels, from (x0, y0) up to but excluding (x1, y1). */
+  struct Tile {
+    long x0; /**< The first column of the tile. */
+    long y0; /**< The first row of the tile. */
+    long x1; /**< One past the last column of the tile. */
+    long y1; /**< One past the last row of the tile. */
+  };
+
+private:
+  /**
+   * The run of tiles left to a worker, packed as the first index in the
+   * high 32 bits and one past the last index in the low 32 bits so that it
+   * can be changed with a single compare-and-swap. Padded to a cache line,
+   * since every worker updates its own run after each tile.
+   */
+  struct Queue {
+    std::atomic<uint64_t> range; /**< The packed run of tiles. */
+    char padding[64 - sizeof(std::atomic<uint64_t>)];
+  };
+
+  std::vector<Tile> tiles; /**< The tiles, in Morton order. */
+  std::vector<Queue> queues; /**< The tiles left to each worker. */
+  std::atomic<size_t> tilesDone; /**< The tiles finished this iteration. */
+
+public:
+  /**
+   * Splits an image into tiles for the given number of workers.
+   *
+   * @param w       the width of the image
+   * @param h       the height of the image
+   * @param workers the number of workers that take tiles; at least 1
+   */
+  TileScheduler(long w, long h, int workers);
+
+  /** Returns the number of tiles. */
+  inline size_t size() const { return tiles.size(); }
+
+  /** Returns the number of workers that the tiles are split between. */
+  inline int workers() const { return int(queues.size()); }
+
+  /** Returns the tile at the given index. */
+  inline const Tile& operator[](size_t idx) const { return tiles[idx]; }
+
+  /**
+   * Starts an iteration, splitting all tiles evenly between the workers.
+   * Must not be called while workers are taking tiles.
+   */
+  void reset();
+
+  /**
+   * Takes the next tile for a worker, stealing from the other workers once
+   * its own run is empty. Safe to call from all workers at once.
+   *
+   * @param worker       the index of the worker, in [0, workers())
+   * @param tileOut [out] the index of the tile taken
+   * @returns            false once no tiles are left in this iteration
+   */
+  bool next(int worker, size_t* tileOut);
+
+  /**
+   * Records that a tile taken with TileScheduler::next has been rendered.
+   */
+  inline void finish() {
+    tilesDone.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Returns the fraction of this iteration's tiles that have been rendered,
+   * in [0, 1]. Safe to call from any thread while workers are running.
+   */
+  float progress() const;
+};
@@ -0,0 +1,93 @@
+#pragma once
+#include "math.h"
+
+/**
+ * A bundle of N 3D vectors stored as structure-of-arrays: one array of N
+ * lanes for each axis. Eigen keeps the lanes in SSE, AVX or NEON registers,
+ * so one operation on the bundle works on all N vectors at once, which Vec,
+ * at an odd 12 bytes, cannot do. The API follows the Eigen calls that the
+ * code uses on Vec, with lane-wise results.
+ *
+ * Arrays of bundles need Eigen::aligned_allocator.
+ */
+template<int N>
+struct Vec3xN {
+  typedef Eigen::Array<float, N, 1> Lanes; /**< One float for each lane. */
+
+  Lanes x; /**< The X-coordinates of the vectors. */
+  Lanes y; /**< The Y-coordinates of the vectors. */
+  Lanes z; /**< The Z-coordinates of the vectors. */
+
+  /** Constructs a bundle of zero vectors. */
+  Vec3xN() : x(Lanes::Zero()), y(Lanes::Zero()), z(Lanes::Zero()) {}
+
+  /** Constructs a bundle from the coordinates of its vectors. */
+  Vec3xN(const Lanes& xs, const Lanes& ys, const Lanes& zs)
+    : x(xs), y(ys), z(zs) {}
+
+  /** Constructs a bundle holding the same vector in every lane. */
+  explicit Vec3xN(const Vec& v)
+    : x(Lanes::Constant(v.x())),
+      y(Lanes::Constant(v.y())),
+      z(Lanes::Constant(v.z())) {}
+
+  /** Returns the vector in the given lane. */
+  inline Vec get(int lane) const {
+    return Vec(x[lane], y[lane], z[lane]);
+  }
+
+  /** Stores a vector in the given lane. */
+  inline void set(int lane, const Vec& v) {
+    x[lane] = v.x();
+    y[lane] = v.y();
+    z[lane] = v.z();
+  }
+
+  inline Vec3xN operator+(const Vec3xN& o) const {
+    return Vec3xN(x + o.x, y + o.y, z + o.z);
+  }
+
+  inline Vec3xN operator-(const Vec3xN& o) const {
+    return Vec3xN(x - o.x, y - o.y, z - o.z);
+  }
+
+  inline Vec3xN operator*(const Lanes& s) const {
+    return Vec3xN(x * s, y * s, z * s);
+  }
+
+  inline Vec3xN operator*(float s) const {
+    return Vec3xN(x * s, y * s, z * s);
+  }
+
+  /** Returns the dot product of each pair of vectors. */
+  inline Lanes dot(const Vec3xN& o) const {
+    return x * o.x + y * o.y + z * o.z;
+  }
+
+  /** Returns the cross product of each pair of vectors. */
+  inline Vec3xN cross(const Vec3xN& o) const {
+    return Vec3xN(y * o.z - z * o.y, z * o.x - x * o.z, x * o.y - y * o.x);
+  }
+
+  /** Returns the component-wise product of each pair of vectors. */
+  inline Vec3xN cwiseProduct(const Vec3xN& o) const {
+    return Vec3xN(x * o.x, y * o.y, z * o.z);
+  }
+
+  /** Returns the squared length of each vector. */
+  inline Lanes squaredNorm() const {
+    return dot(*this);
+  }
+
+  /** Returns the length of each vector. */
+  inline Lanes norm() const {
+    return squaredNorm().sqrt();
+  }
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+typedef Vec3xN<4> Vec3x4; /**< Four vectors, filling SSE or NEON registers. */
+typedef Vec3xN<8> Vec3x8; /**< Eight vectors, filling AVX registers. */
+/** Sixteen vectors, filling AVX-512 registers. */
+typedef Vec3xN<16> Vec3x16;
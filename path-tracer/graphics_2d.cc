@@ -8,6 +8,7 @@
 #include <atomic>
 #include <thread>
 #include <sstream>
+#include <stdexcept>
 
 #include "ppapi/c/ppb_image_data.h"
 #include "ppapi/cpp/graphics_2d.h"
@@ -16,6 +17,7 @@
 #include "ppapi/cpp/instance.h"
 #include "ppapi/cpp/module.h"
 #include "ppapi/cpp/point.h"
+#include "ppapi/cpp/var.h"
 #include "ppapi/utility/completion_callback_factory.h"
 
 #include "core/scene.h"
@@ -36,10 +38,13 @@ const std::string kSceneDescription = R"(
       "sunLight" : {
         "type" : "area",
         "color" : "10 10 10"
-      },
-      "skyLight" : {
-        "type" : "area",
-        "color" : "0.3 0.4 0.5"
+      }
+    },
+    "environments" : {
+      "sky" : {
+        "type" : "environment",
+        "color" : "0.6 0.8 1",
+        "image" : ""
       }
     },
     "materials" : {
@@ -47,10 +52,6 @@ const std::string kSceneDescription = R"(
         "type" : "lambert",
         "albedo" : "0.4 0.3 0.2"
       },
-      "sky" : {
-        "type" : "lambert",
-        "albedo" : "0.4 0.5 0.6"
-      },
       "dielectric" : {
         "type" : "dielectric",
         "ior" : 1.5,
@@ -73,14 +74,6 @@ const std::string kSceneDescription = R"(
       }
     },
     "geometry" : {
-      "worldSphere" : {
-        "type" : "sphere",
-        "mat" : "sky",
-        "light" : "skyLight",
-        "origin" : "0 0 0",
-        "radius" : 2000.0,
-        "inverted" : true
-      },
       "bottom" : {
         "type" : "disc",
         "mat" : "ground",
@@ -186,15 +179,22 @@ const std::string kSceneDescription = R"(
         "rotateAngle" :  -0.26180,
         "rotateAxis" : "1 0 0",
         "objects" : [
-          "worldSphere", "bottom", "lightSource", "sphere1", "sphere2",
-          "sphere3", "sphere4", "sphere5", "sphere6", "sphere7", "sphere8",
-          "sphere9", "sphere10"
+          "bottom", "lightSource", "sphere1", "sphere2", "sphere3", "sphere4",
+          "sphere5", "sphere6", "sphere7", "sphere8", "sphere9", "sphere10"
         ],
+        "environment" : "sky",
         "width" : 512,
         "height" : 384,
         "fov" : 0.78540,
         "focalLength" : 88.0,
-        "fStop" : 16.0
+        "fStop" : 16.0,
+        "integrator" : "path",
+        "denoiseInterval" : 0,
+        "radianceCache" : false,
+        "directLighting" : true,
+        "clampRadiance" : true,
+        "adjointRussianRoulette" : false,
+        "lightCandidates" : 1
       }
     }
   }
@@ -208,6 +208,9 @@ class Graphics2DInstance : public pp::Instance {
       : pp::Instance(instance),
         callback_factory_(this),
         core_image_(NULL),
+        camera_(NULL),
+        output_(Image::Output::BEAUTY),
+        progress_percent_(-1),
         device_scale_(1.0f) {}
 
   ~Graphics2DInstance() {}
@@ -231,6 +234,7 @@ class Graphics2DInstance : public pp::Instance {
 
     Graphics2DInstance* g2d = reinterpret_cast<Graphics2DInstance*>(data);
     g2d->core_image_ = scene.defaultCamera()->getImagePtr();
+    g2d->camera_ = scene.defaultCamera();
     scene.defaultCamera()->renderMultiple(g2d->needs_paint_, -1);
     return NULL;
   }
@@ -256,6 +260,36 @@ class Graphics2DInstance : public pp::Instance {
       MainLoop(0);
   }
 
+  // Switches the image buffer being shown, e.g. "output:normal", or the
+  // integrator rendering it, e.g. "integrator:ao". Unknown names are
+  // reported and otherwise ignored.
+  virtual void HandleMessage(const pp::Var& message) {
+    if (!message.is_string()) {
+      return;
+    }
+
+    const std::string outputPrefix = "output:";
+    const std::string integratorPrefix = "integrator:";
+    std::string text = message.AsString();
+    bool isOutput = text.compare(0, outputPrefix.size(), outputPrefix) == 0;
+    bool isIntegrator =
+      text.compare(0, integratorPrefix.size(), integratorPrefix) == 0;
+    Camera* camera = camera_.load();
+    try {
+      if (isOutput) {
+        output_ = Image::outputFromName(text.substr(outputPrefix.size()));
+        needs_paint_ = true;
+      } else if (isIntegrator && camera) {
+        camera->setIntegrator(
+          Camera::integratorFromName(text.substr(integratorPrefix.size()))
+        );
+      }
+    } catch (const std::runtime_error& e) {
+      fprintf(stderr, "Ignoring message \"%s\": %s\n", text.c_str(),
+              e.what());
+    }
+  }
+
  private:
   bool CreateContext(const pp::Size& new_size) {
     const bool kIsAlwaysOpaque = true;
@@ -283,15 +317,33 @@ class Graphics2DInstance : public pp::Instance {
 
     needs_paint_ = false;
 
-    if (core_image_) {
+    Image* image = core_image_.load();
+    if (image) {
       pp::ImageData img(this, PP_IMAGEDATAFORMAT_RGBA_PREMUL, size_, false);
       int counter;
-      core_image_->writeToNaClImage(&img, &counter);
+      image->writeToNaClImage(&img, &counter, output_);
       context_.ReplaceContents(&img);
       PostMessage(pp::Var(counter));
     }
   }
 
+  // Posts how much of the current iteration is rendered, in whole percent,
+  // whenever that changes.
+  void PostProgress() {
+    Camera* camera = camera_.load();
+    if (!camera) {
+      return;
+    }
+
+    int percent = static_cast<int>(camera->iterationProgress() * 100.0f);
+    if (percent != progress_percent_) {
+      progress_percent_ = percent;
+      std::ostringstream message;
+      message << "progress:" << percent;
+      PostMessage(pp::Var(message.str()));
+    }
+  }
+
   void MainLoop(int32_t) {
     if (context_.is_null()) {
       // The current Graphics2D context is null, so updating and rendering is
@@ -302,6 +354,7 @@ class Graphics2DInstance : public pp::Instance {
     }
 
     Paint();
+    PostProgress();
 
     // Store a reference to the context that is being flushed; this ensures
     // the callback is called, even if context_ changes before the flush
@@ -315,7 +368,12 @@ class Graphics2DInstance : public pp::Instance {
   pp::Graphics2D context_;
   pp::Graphics2D flush_context_;
   pp::Size size_;
-  Image* core_image_;
+  // Set once by the render thread, and read from the main thread.
+  std::atomic<Image*> core_image_;
+  std::atomic<Camera*> camera_;
+  Image::Output output_;
+  // The last progress posted, only used on the main thread.
+  int progress_percent_;
   std::atomic<bool> needs_paint_;
   float device_scale_;
 };
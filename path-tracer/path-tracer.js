@@ -1,6 +1,14 @@
 var startTime = new Date();
 
 function handleMessage(message) {
+  // Progress through the current iteration comes as "progress:<percent>".
+  if (typeof message.data === 'string' &&
+      message.data.lastIndexOf('progress:', 0) === 0) {
+    document.getElementById('iterationProgress').textContent =
+      message.data.slice('progress:'.length);
+    return;
+  }
+
   document.getElementById('iterationCount').textContent = message.data;
 
   var curTime = new Date();
@@ -8,6 +16,16 @@ function handleMessage(message) {
   document.getElementById('timer').textContent = timeString;
 }
 
+function changeOutput(name) {
+  common.naclModule.postMessage('output:' + name);
+}
+
+function changeIntegrator(name) {
+  // The image starts over with the new integrator.
+  startTime = new Date();
+  common.naclModule.postMessage('integrator:' + name);
+}
+
 function getTimeString(duration) {
   const SECOND = 1000;
   const MINUTE = 60 * SECOND;
@@ -0,0 +1,142 @@
+#include <cstdio>
+#include <vector>
+#include "../core/lights/distant.h"
+#include "../core/lights/occluded.h"
+
+/*
+ * Checks which emitters lights::Distant::variation lets the camera replace
+ * with distant lights, starting with the sun in the built-in scene, and that
+ * a distant light hides what is behind it.
+ */
+
+namespace {
+
+  /** The number of failed checks so far. */
+  int failures = 0;
+
+  /**
+   * Reports the variation of an emitter across some receivers, and counts a
+   * failure if it is not replaced as expected.
+   */
+  void check(
+    const char* name,
+    const BSphere& emitter,
+    const BBox& receivers,
+    bool replaced
+  ) {
+    float variation = lights::Distant::variation(emitter, receivers);
+    bool ok = (variation <= lights::Distant::TOLERANCE) == replaced;
+    printf("%-40s %10.3g (%s) %s\n", name, variation,
+           replaced ? "replaced" : "kept", ok ? "ok" : "FAILED");
+    if (!ok) {
+      failures++;
+    }
+  }
+
+  /** Returns the bounds of the glass spheres in the built-in scene. */
+  BBox builtInSpheres() {
+    // See kSceneDescription in graphics_2d.cc.
+    BBox box(Vec(6, -20, -32), Vec(26, 0, -12));
+    for (int i = 1; i < 10; ++i) {
+      Vec center(16.0f - 14.0f * float(i), -10.0f, -22.0f - 18.0f * float(i));
+      box.expand(center - Vec(10, 10, 10));
+      box.expand(center + Vec(10, 10, 10));
+    }
+    return box;
+  }
+
+  /**
+   * A uniform sky that always samples straight up, with the PDF of uniform
+   * sphere sampling.
+   */
+  class Sky : public InfiniteLight {
+  public:
+    virtual Vec emit(const Vec& dir) const override {
+      return Vec(1, 1, 1);
+    }
+    virtual void sampleDirection(
+      Randomness& rng,
+      Vec* dirOut,
+      Vec* colorOut,
+      float* pdfOut
+    ) const override {
+      *dirOut = Vec(0, 1, 0);
+      *colorOut = emit(*dirOut);
+      *pdfOut = pdf(*dirOut);
+    }
+    virtual float pdf(const Vec& dir) const override {
+      return 0.25f * math::INV_PI;
+    }
+    virtual float power(const BSphere& sceneBounds) const override {
+      return 1.0f;
+    }
+  };
+
+  /**
+   * Counts a failure, and reports it, if the given condition does not hold.
+   */
+  void expect(const char* name, bool ok) {
+    printf("%-40s %s\n", name, ok ? "ok" : "FAILED");
+    if (!ok) {
+      failures++;
+    }
+  }
+
+  /**
+   * Checks that a sun overhead blocks the sky within its cone, and only
+   * there, without changing how the sky is sampled.
+   */
+  void checkOccluded() {
+    Sky sky;
+    lights::Distant sun(Vec(0, 1, 0), 0.1f, Vec(100, 100, 100));
+    lights::Occluded occluded(&sky, std::vector<const lights::Distant*>{&sun});
+
+    Vec up(0, 1, 0);
+    Vec side = Vec(1, 1, 0).normalized();
+    expect("sky behind the sun is hidden", occluded.emit(up).isZero());
+    expect("sky beside the sun is seen", occluded.emit(side) == sky.emit(side));
+
+    Randomness rng(1);
+    Vec dir;
+    Vec color;
+    float pdf;
+    occluded.sampleDirection(rng, &dir, &color, &pdf);
+    expect("sampled sky behind the sun is hidden", color.isZero());
+    expect("sampled sky keeps its pdf", pdf == sky.pdf(dir));
+    expect("sky pdf behind the sun is kept", occluded.pdf(up) == sky.pdf(up));
+  }
+
+}
+
+int main() {
+  BSphere builtInSun(Vec(0, 2500, 0), 1000.0f);
+  BBox spheres = builtInSpheres();
+  BBox withGround = spheres;
+  withGround.expand(Vec(-2001, -20, -2001));
+  withGround.expand(Vec(2001, -20, 2001));
+
+  // The ground reaches in under the sun, so the sun lights it from very
+  // different directions.
+  check("built-in sun over the whole scene", builtInSun, withGround, false);
+
+  // Even the spheres alone are too close: the sun spans 23 degrees and is
+  // 2.5 of its radii away, so its solid angle changes by 20% across them.
+  check("built-in sun over the spheres", builtInSun, spheres, false);
+
+  // Moved as far away as in a sunlit scene, it stands in for the sun over
+  // the spheres. The built-in ground is still 28% of its size, though, so
+  // the sun would look shifted from one edge of the ground to the other.
+  BSphere farSun(Vec(300000, 800000, 200000), 10000.0f);
+  check("far sun over the spheres", farSun, spheres, true);
+  check("far sun over the whole scene", farSun, withGround, false);
+
+  // With a ground only as large as the spheres need, it does.
+  BBox smallGround = spheres;
+  smallGround.expand(Vec(-60, -20, -60));
+  smallGround.expand(Vec(60, -20, 60));
+  check("far sun over a small ground", farSun, smallGround, true);
+
+  checkOccluded();
+
+  return failures == 0 ? 0 : 1;
+}
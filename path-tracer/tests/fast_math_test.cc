@@ -0,0 +1,186 @@
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include "../core/fast_math.h"
+
+/*
+ * Checks the approximations in fast_math.h against the double-precision
+ * functions, over random arguments in each documented domain, and fails if
+ * any error exceeds the bound in the table there.
+ */
+
+namespace {
+
+  /** The number of random arguments tried for each function. */
+  static constexpr int SAMPLES = 2000000;
+
+  /** The number of failed checks so far. */
+  int failures = 0;
+
+  /**
+   * Returns the error of an approximation in units in the last place of the
+   * exact value rounded to a float.
+   */
+  double ulpError(float approx, double exact) {
+    float rounded = fabsf(float(exact));
+    double ulp = double(nextafterf(rounded, INFINITY) - rounded);
+    return fabs(double(approx) - exact) / ulp;
+  }
+
+  /**
+   * Reports the largest error seen for a function, and counts a failure if
+   * it is over the bound.
+   */
+  void check(const char* name, double worst, double bound) {
+    bool ok = worst <= bound;
+    printf("%-28s %10.3g (bound %g) %s\n", name, worst, bound,
+           ok ? "ok" : "FAILED");
+    if (!ok) {
+      failures++;
+    }
+  }
+
+  void testSinCos(std::mt19937& rng) {
+    // Half the angles are small, where most of the sampling happens.
+    std::uniform_real_distribution<float> wide(-8192.0f, 8192.0f);
+    std::uniform_real_distribution<float> narrow(-7.0f, 7.0f);
+    double worstSin = 0.0;
+    double worstCos = 0.0;
+    double worstAbsolute = 0.0;
+    for (int i = 0; i < SAMPLES; ++i) {
+      float x = i % 2 ? wide(rng) : narrow(rng);
+      float s;
+      float c;
+      math::fast::sincos(x, &s, &c);
+
+      // Near the zeros, where an ULP vanishes, the bound is absolute.
+      double exact[2] = {sin(double(x)), cos(double(x))};
+      float approx[2] = {s, c};
+      double* worst[2] = {&worstSin, &worstCos};
+      for (int k = 0; k < 2; ++k) {
+        if (fabs(exact[k]) > 1e-3) {
+          *worst[k] = fmax(*worst[k], ulpError(approx[k], exact[k]));
+        } else {
+          worstAbsolute = fmax(
+            worstAbsolute,
+            fabs(double(approx[k]) - exact[k])
+          );
+        }
+      }
+    }
+    check("sin (ULP)", worstSin, 1.6);
+    check("cos (ULP)", worstCos, 1.6);
+    check("sin, cos near 0 (absolute)", worstAbsolute, 8e-8);
+  }
+
+  void testExp(std::mt19937& rng) {
+    std::uniform_real_distribution<float> dist(-87.3f, 88.3f);
+    double worst = 0.0;
+    for (int i = 0; i < SAMPLES; ++i) {
+      float x = dist(rng);
+      worst = fmax(worst, ulpError(math::fast::exp(x), exp(double(x))));
+    }
+    check("exp (ULP)", worst, 1.0);
+  }
+
+  void testLog(std::mt19937& rng) {
+    // Spread the arguments evenly over the exponents of normal floats.
+    std::uniform_real_distribution<float> exponent(-125.0f, 127.0f);
+    double worst = 0.0;
+    for (int i = 0; i < SAMPLES; ++i) {
+      float x = exp2f(exponent(rng));
+      double exact = log(double(x));
+      if (exact != 0.0) {
+        worst = fmax(worst, ulpError(math::fast::log(x), exact));
+      }
+    }
+    check("log (ULP)", worst, 0.8);
+  }
+
+  void testPow(std::mt19937& rng) {
+    // Half the exponents are glossy, half are fractional.
+    std::uniform_real_distribution<float> base(0.0f, 1.0f);
+    std::uniform_real_distribution<float> exponent(0.0f, 2000.0f);
+    double worstExcess = 0.0;
+    double worstRelative = 0.0;
+    for (int i = 0; i < SAMPLES; ++i) {
+      float x = base(rng);
+      float y = i % 2 ? exponent(rng) : 1.0f / (1.0f + exponent(rng));
+      double magnified = fabs(double(y) * log(double(x)));
+      if (x == 0.0f || magnified > 87.0) {
+        continue;
+      }
+
+      float approx = math::fast::pow(x, y);
+      double exact = pow(double(x), double(y));
+      worstExcess = fmax(
+        worstExcess,
+        ulpError(approx, exact) - 2.0 * magnified
+      );
+      worstRelative = fmax(
+        worstRelative,
+        fabs(double(approx) - exact) / exact
+      );
+    }
+    check("pow (ULP - 2 * |y log x|)", worstExcess, 1.0);
+    check("pow (relative)", worstRelative, 2e-5);
+    check("pow(0, 0)", fabs(double(math::fast::pow(0.0f, 0.0f))), 0.0);
+    check("pow(0, 5)", fabs(double(math::fast::pow(0.0f, 5.0f))), 0.0);
+  }
+
+  void testSqrt(std::mt19937& rng) {
+    std::uniform_real_distribution<float> exponent(-125.0f, 127.0f);
+    double worst = 0.0;
+    for (int i = 0; i < SAMPLES; ++i) {
+      float x = exp2f(exponent(rng));
+      worst = fmax(worst, ulpError(math::fast::sqrt(x), sqrt(double(x))));
+    }
+    check("sqrt (ULP)", worst, 0.9);
+    check("sqrt(0)", fabs(double(math::fast::sqrt(0.0f))), 0.0);
+  }
+
+  /** Checks that the wide variants give exactly the scalar results. */
+  void testWide(std::mt19937& rng) {
+    static constexpr size_t N = math::fast::LANES;
+    std::uniform_real_distribution<float> dist(0.0f, 4.0f);
+    float x[N];
+    float s[N];
+    float c[N];
+    float e[N];
+    float l[N];
+    float p[N];
+    double mismatches = 0.0;
+    for (int i = 0; i < SAMPLES / int(N); ++i) {
+      for (size_t j = 0; j < N; ++j) {
+        x[j] = dist(rng);
+      }
+
+      math::fast::sincosN<N>(x, s, c);
+      math::fast::expN<N>(x, e);
+      math::fast::logN<N>(x, l);
+      math::fast::powN<N>(x, 37.0f, p);
+      for (size_t j = 0; j < N; ++j) {
+        bool same = s[j] == math::fast::sin(x[j])
+          && c[j] == math::fast::cos(x[j])
+          && e[j] == math::fast::exp(x[j])
+          && l[j] == math::fast::log(x[j])
+          && p[j] == math::fast::pow(x[j], 37.0f);
+        mismatches += same ? 0.0 : 1.0;
+      }
+    }
+    check("wide variants (mismatches)", mismatches, 0.0);
+  }
+
+}
+
+int main() {
+  std::mt19937 rng(1);
+  testSinCos(rng);
+  testExp(rng);
+  testLog(rng);
+  testPow(rng);
+  testSqrt(rng);
+  testWide(rng);
+
+  return failures == 0 ? 0 : 1;
+}